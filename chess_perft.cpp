@@ -0,0 +1,489 @@
+// chess_perft: headless move generator check and benchmark
+//
+// counts the leaf nodes of the legal move tree from a position and compares
+// them against known results, see https://www.chessprogramming.org/Perft_Results
+//
+//   chess_perft <depth> [fen]           perft from fen (default: start position)
+//   chess_perft --divide <depth> [fen]  node count below every root move
+//   chess_perft --suite [max depth]     standard positions against their known counts
+//   chess_perft --batch [max depth]     every position of the suite trees through ChessBatch, checked
+//                                       against generateAllCurrentMoves (default depth: 3)
+//
+// options, in front of any of these:
+//   --threads <n>  split the tree over n threads (default: every core)
+//   --hash <mb>    size of the shared perft hash, 0 turns it off (default: 64)
+//   --staged       walk the tree through MovePicker instead, feeding it moves
+//                  from sibling subtrees as hash and killer moves
+//   --incremental  keep every piece's attacks cached and patched by make/unmake
+//                  instead of looking the sliders up again at every node
+//
+#include "classes/ChessPosition.h"
+#include "classes/ChessBatch.h"
+#include "classes/MovePicker.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+struct PerftCase
+{
+    const char* name;
+    const char* fen;
+    std::vector<uint64_t> nodes; // nodes[d - 1] is the count at depth d
+};
+
+static const PerftCase PerftSuite[] = {
+    { "startpos", StartFEN,
+      { 20, 400, 8902, 197281, 4865609, 119060324 } },
+    { "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+      { 48, 2039, 97862, 4085603, 193690690 } },
+    { "position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+      { 14, 191, 2812, 43238, 674624, 11030083 } },
+    { "position4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+      { 6, 264, 9467, 422333, 15833292 } },
+    { "position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+      { 44, 1486, 62379, 2103487, 89941194 } },
+    { "position6", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+      { 46, 2079, 89890, 3894594, 164075551 } },
+};
+
+static std::string squareName(int square)
+{
+    return std::string(1, (char)('a' + square % 8)) + (char)('1' + square / 8);
+}
+
+static std::string moveName(const BitMove& move)
+{
+    std::string name = squareName(move.from()) + squareName(move.to());
+    if (move.isPromotion()) {
+        name += "nbrq"[move.promotion() - Knight];
+    }
+    return name;
+}
+
+static bool Staged = false;
+static bool Incremental = false;
+static int Threads = 1;
+
+// per remaining depth: the last move tried and the last two quiets, from whatever subtree came before
+static thread_local BitMove StagedHash[64];
+static thread_local BitMove StagedKillers[64][2];
+
+// subtree counts shared by every thread, without locks
+// an entry stores key ^ data next to data, so a torn write from two threads fails the key check
+// instead of handing back the wrong count
+class PerftHash
+{
+public:
+    void resize(size_t megabytes) {
+        size_t count = 0;
+        size_t bytes = megabytes * 1024 * 1024;
+        if (bytes >= sizeof(Entry)) {
+            count = std::bit_floor(bytes / sizeof(Entry));
+        }
+        _entries = std::vector<Entry>(count);
+        _mask = count ? count - 1 : 0;
+    }
+
+    bool probe(uint64_t key, int depth, uint64_t& nodes) const {
+        if (_entries.empty()) {
+            return false;
+        }
+        const Entry& entry = _entries[index(key, depth)];
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        uint64_t check = entry.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || (int)(data & 0xFF) != depth) {
+            return false;
+        }
+        nodes = data >> 8;
+        return true;
+    }
+
+    void store(uint64_t key, int depth, uint64_t nodes) {
+        if (_entries.empty()) {
+            return;
+        }
+        Entry& entry = _entries[index(key, depth)];
+        uint64_t data = (nodes << 8) | (uint64_t)depth;
+        entry.data.store(data, std::memory_order_relaxed);
+        entry.check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    // the same position at different depths goes to different slots
+    size_t index(uint64_t key, int depth) const {
+        return (size_t)((key ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ULL)) & _mask);
+    }
+
+    std::vector<Entry> _entries;
+    uint64_t _mask = 0;
+};
+
+static PerftHash Hash;
+
+static uint64_t perft(ChessPosition& position, int depth);
+
+static uint64_t stagedPerft(ChessPosition& position, int depth)
+{
+    uint64_t nodes = 0;
+    BitMove move;
+    MovePicker picker(position, StagedHash[depth], StagedKillers[depth]);
+    while (picker.next(move)) {
+        position.makeMove(move);
+        nodes += perft(position, depth - 1);
+        position.unmakeMove(move);
+
+        StagedHash[depth] = move;
+        if (!move.isCapture() && !move.isPromotion() && move != StagedKillers[depth][0]) {
+            StagedKillers[depth][1] = StagedKillers[depth][0];
+            StagedKillers[depth][0] = move;
+        }
+    }
+    return nodes;
+}
+
+static uint64_t perft(ChessPosition& position, int depth)
+{
+    if (depth == 0) {
+        return 1;
+    }
+    if (Staged) {
+        return stagedPerft(position, depth);
+    }
+
+    MoveList moves;
+    position.generateAllCurrentMoves(moves);
+    // every legal move is a leaf one ply from the bottom, no need to play them
+    if (depth == 1) {
+        return moves.size();
+    }
+
+    uint64_t nodes = 0;
+    if (Hash.probe(position.getHash(), depth, nodes)) {
+        return nodes;
+    }
+    for (const BitMove& move : moves) {
+        position.makeMove(move);
+        nodes += perft(position, depth - 1);
+        position.unmakeMove(move);
+    }
+    Hash.store(position.getHash(), depth, nodes);
+    return nodes;
+}
+
+// a root move, and with deep enough trees one reply to it, whose subtree one thread counts
+struct PerftTask
+{
+    int root;
+    BitMove first;
+    BitMove second;
+};
+
+// splits the tree two plies down (one for shallow trees) and hands the subtrees out to the threads
+// returns the count below every root move, in generator order
+static std::vector<uint64_t> parallelPerft(ChessPosition& position, int depth, MoveList& rootMoves)
+{
+    position.generateAllCurrentMoves(rootMoves);
+    bool splitReplies = depth >= 3;
+
+    std::vector<PerftTask> tasks;
+    for (int i = 0; i < rootMoves.size(); i++) {
+        if (!splitReplies) {
+            tasks.push_back({ i, rootMoves[i], NoMove });
+            continue;
+        }
+        MoveList replies;
+        position.makeMove(rootMoves[i]);
+        position.generateAllCurrentMoves(replies);
+        position.unmakeMove(rootMoves[i]);
+        for (const BitMove& reply : replies) {
+            tasks.push_back({ i, rootMoves[i], reply });
+        }
+    }
+
+    std::vector<std::atomic<uint64_t>> counts(rootMoves.size());
+    std::atomic<size_t> nextTask{0};
+    auto worker = [&]() {
+        ChessPosition local = position;
+        if (Staged) {
+            std::fill(&StagedHash[0], &StagedHash[0] + 64, NoMove);
+            std::fill(&StagedKillers[0][0], &StagedKillers[0][0] + 64 * 2, NoMove);
+        }
+        for (size_t t = nextTask++; t < tasks.size(); t = nextTask++) {
+            const PerftTask& task = tasks[t];
+            int remaining = depth - 1;
+            local.makeMove(task.first);
+            if (task.second != NoMove) {
+                local.makeMove(task.second);
+                remaining--;
+            }
+            uint64_t nodes = remaining > 0 ? perft(local, remaining) : 1;
+            if (task.second != NoMove) {
+                local.unmakeMove(task.second);
+            }
+            local.unmakeMove(task.first);
+            counts[task.root] += nodes;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < Threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+
+    std::vector<uint64_t> result;
+    for (const std::atomic<uint64_t>& count : counts) {
+        result.push_back(count.load());
+    }
+    return result;
+}
+
+static uint64_t totalPerft(ChessPosition& position, int depth)
+{
+    MoveList rootMoves;
+    uint64_t nodes = 0;
+    for (uint64_t count : parallelPerft(position, depth, rootMoves)) {
+        nodes += count;
+    }
+    return nodes;
+}
+
+static uint64_t divide(ChessPosition& position, int depth)
+{
+    MoveList moves;
+    std::vector<uint64_t> counts = parallelPerft(position, depth, moves);
+
+    uint64_t nodes = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        std::cout << moveName(moves[i]) << ": " << counts[i] << "\n";
+        nodes += counts[i];
+    }
+    std::cout << "\nmoves: " << moves.size() << "\n";
+    return nodes;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printSpeed(uint64_t nodes, double seconds)
+{
+    std::cout << "nodes: " << nodes << "  time: " << seconds << "s  nps: "
+              << (uint64_t)(seconds > 0.0 ? nodes / seconds : 0.0) << std::endl;
+}
+
+static int runSuite(int maxDepth)
+{
+    int failures = 0;
+    uint64_t totalNodes = 0;
+    std::cout << "sliders: " << ChessPosition::sliderBackend() << "  threads: " << Threads << "\n\n";
+    auto suiteStart = std::chrono::steady_clock::now();
+
+    for (const PerftCase& test : PerftSuite) {
+        ChessPosition position;
+        position.loadFEN(test.fen);
+        position.setIncrementalAttacks(Incremental);
+
+        int depth = std::min<int>(maxDepth, (int)test.nodes.size());
+        for (int d = 1; d <= depth; d++) {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t nodes = totalPerft(position, d);
+            double seconds = secondsSince(start);
+            bool ok = nodes == test.nodes[d - 1];
+
+            std::cout << (ok ? "ok   " : "FAIL ") << test.name << " depth " << d << ": " << nodes;
+            if (!ok) {
+                std::cout << " (expected " << test.nodes[d - 1] << ")";
+            }
+            std::cout << "  " << (uint64_t)(seconds > 0.0 ? nodes / seconds : 0.0) << " nps" << std::endl;
+
+            failures += ok ? 0 : 1;
+            totalNodes += nodes;
+        }
+    }
+
+    std::cout << "\n";
+    printSpeed(totalNodes, secondsSince(suiteStart));
+    std::cout << (failures ? "FAILED: " : "passed, failures: ") << failures << std::endl;
+    return failures ? 1 : 0;
+}
+
+// what ChessBatch has to reproduce for one position: the pawn (no en passant), knight and king (no castling) moves
+// generateAllCurrentMoves gives, sorted, and the occupancy of either side
+struct BatchExpectation
+{
+    std::vector<uint16_t> moves;
+    uint64_t own;
+    uint64_t enemy;
+};
+
+static void collectPositions(ChessPosition& position, int depth, ChessBatch& batch, std::vector<BatchExpectation>& expected)
+{
+    MoveList moves;
+    position.generateAllCurrentMoves(moves);
+    batch.add(position);
+
+    BatchExpectation wanted;
+    for (BitMove move : moves) {
+        ChessPiece piece = position.pieceTypeOn(move.from());
+        bool covered = piece == Pawn || piece == Knight || piece == King;
+        if (covered && move.flags() != EnPassantCapture && !move.isCastle()) {
+            wanted.moves.push_back(move.data);
+        }
+    }
+    std::sort(wanted.moves.begin(), wanted.moves.end());
+    wanted.own = position.getPieces(position.sideToMove());
+    wanted.enemy = position.getPieces(position.sideToMove() ^ 1);
+    expected.push_back(std::move(wanted));
+
+    if (depth == 0) {
+        return;
+    }
+    for (BitMove move : moves) {
+        position.makeMove(move);
+        collectPositions(position, depth - 1, batch, expected);
+        position.unmakeMove(move);
+    }
+}
+
+static int runBatch(int maxDepth)
+{
+    int failures = 0;
+    std::cout << "batch: " << ChessBatch::backend() << ", " << ChessBatch::lanes() << " positions per instruction\n\n";
+
+    for (const PerftCase& test : PerftSuite) {
+        ChessPosition position;
+        position.loadFEN(test.fen);
+        position.setIncrementalAttacks(Incremental);
+        ChessBatch batch;
+        std::vector<BatchExpectation> expected;
+        collectPositions(position, maxDepth, batch, expected);
+
+        auto start = std::chrono::steady_clock::now();
+        batch.generate();
+        double seconds = secondsSince(start);
+
+        int mismatches = 0;
+        MoveList moves;
+        for (int lane = 0; lane < batch.size(); lane++) {
+            batch.getMoves(lane, moves);
+            std::vector<uint16_t> got;
+            for (BitMove move : moves) {
+                got.push_back(move.data);
+            }
+            std::sort(got.begin(), got.end());
+            const BatchExpectation& wanted = expected[lane];
+            if (got != wanted.moves || batch.ownPieces(lane) != wanted.own || batch.enemyPieces(lane) != wanted.enemy) {
+                mismatches++;
+            }
+        }
+
+        std::cout << (mismatches ? "FAIL " : "ok   ") << test.name << ": " << batch.size() << " positions, "
+                  << mismatches << " mismatched  "
+                  << (uint64_t)(seconds > 0.0 ? batch.size() / seconds : 0.0) << " positions/s" << std::endl;
+        failures += mismatches ? 1 : 0;
+    }
+
+    std::cout << (failures ? "FAILED: " : "passed, failures: ") << failures << std::endl;
+    return failures ? 1 : 0;
+}
+
+static void usage()
+{
+    std::cout << "usage: chess_perft [options] <depth> [fen]\n"
+              << "       chess_perft [options] --divide <depth> [fen]\n"
+              << "       chess_perft [options] --suite [max depth]\n"
+              << "       chess_perft --batch [max depth]\n"
+              << "options: --threads <n>  --hash <mb>  --staged  --incremental\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    Threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMegabytes = 64;
+    while (!args.empty()) {
+        if (args[0] == "--staged") {
+            Staged = true;
+        } else if (args[0] == "--incremental") {
+            Incremental = true;
+        } else if (args[0] == "--threads" && args.size() > 1) {
+            Threads = std::max(1, std::atoi(args[1].c_str()));
+            args.erase(args.begin());
+        } else if (args[0] == "--hash" && args.size() > 1) {
+            hashMegabytes = (size_t) std::max(0, std::atoi(args[1].c_str()));
+            args.erase(args.begin());
+        } else {
+            break;
+        }
+        args.erase(args.begin());
+    }
+    // the staged walk is there to exercise the picker at every node, so it gets no hash
+    Hash.resize(Staged ? 0 : hashMegabytes);
+
+    if (args.empty()) {
+        usage();
+        return 1;
+    }
+
+    if (args[0] == "--suite") {
+        return runSuite(args.size() > 1 ? std::atoi(args[1].c_str()) : 5);
+    }
+
+    if (args[0] == "--batch") {
+        return runBatch(args.size() > 1 ? std::atoi(args[1].c_str()) : 3);
+    }
+
+    bool divideMode = args[0] == "--divide";
+    size_t next = divideMode ? 1 : 0;
+    if (next >= args.size()) {
+        usage();
+        return 1;
+    }
+
+    int depth = std::atoi(args[next].c_str());
+    std::string fen = StartFEN;
+    if (next + 1 < args.size()) {
+        // allow the fen unquoted, as separate arguments
+        fen.clear();
+        for (size_t i = next + 1; i < args.size(); i++) {
+            fen += (fen.empty() ? "" : " ") + args[i];
+        }
+    }
+    if (depth < 1) {
+        usage();
+        return 1;
+    }
+
+    ChessPosition position;
+    if (!position.loadFEN(fen)) {
+        std::cout << "invalid fen: " << fen << "\n";
+        usage();
+        return 1;
+    }
+    position.setIncrementalAttacks(Incremental);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t nodes = divideMode ? divide(position, depth) : totalPerft(position, depth);
+    printSpeed(nodes, secondsSince(start));
+    return 0;
+}
@@ -1,8 +1,7 @@
 #pragma once
 
-#ifdef _MSC_VER
-#include <intrin.h>
-#endif
+#include <bit>
+#include <cstdint>
 #include <iostream>
 
 enum ChessPiece
@@ -16,31 +15,103 @@ enum ChessPiece
     King
 };
 
+// sides of the board
+inline constexpr uint64_t FILE_A = 0x0101010101010101ULL;
+inline constexpr uint64_t FILE_H = 0x8080808080808080ULL;
+inline constexpr uint64_t RANK_1 = 0x00000000000000FFULL;
+inline constexpr uint64_t RANK_4 = 0x00000000FF000000ULL;
+inline constexpr uint64_t RANK_5 = 0x000000FF00000000ULL;
+inline constexpr uint64_t RANK_8 = 0xFF00000000000000ULL;
+
+// compass directions as square offsets, a1 = 0 and h8 = 63
+enum Direction : int
+{
+    North = 8,
+    South = -8,
+    East = 1,
+    West = -1,
+    NorthEast = 9,
+    NorthWest = 7,
+    SouthEast = -7,
+    SouthWest = -9
+};
+
 class BitboardElement {
   public:
     // Constructors
-    BitboardElement()
+    constexpr BitboardElement()
         : _data(0) { }
-    BitboardElement(uint64_t data)
+    constexpr BitboardElement(uint64_t data)
         : _data(data) { }
 
     // Getters and Setters
-    uint64_t getData() const { return _data; }
-    void setData(uint64_t data) { _data = data; }
+    constexpr uint64_t getData() const { return _data; }
+    constexpr void setData(uint64_t data) { _data = data; }
+
+    constexpr bool empty() const { return _data == 0; }
+    constexpr int count() const { return std::popcount(_data); }
+    constexpr bool contains(int square) const { return (_data >> square) & 1; }
+    // lowest set square, only meaningful when the board isn't empty
+    constexpr int lsb() const { return std::countr_zero(_data); }
+    // takes the lowest set square off the board and returns it
+    constexpr int popLsb() {
+        int square = lsb();
+        _data &= _data - 1;
+        return square;
+    }
 
     // Method to loop through each bit in the element and perform an operation on it.
     template <typename Func>
-    void forEachBit(Func func) const {
-        if (_data != 0) {
-            uint64_t tempData = _data;
-            while (tempData) {
-                int index = bitScanForward(tempData);
-                func(index);
-                tempData &= tempData - 1;
-            }
+    constexpr void forEachBit(Func func) const {
+        for (uint64_t bits = _data; bits; bits &= bits - 1) {
+            func(std::countr_zero(bits));
         }
     }
 
+    // or with range-for: for (int square : board)
+    class Iterator {
+      public:
+        constexpr Iterator(uint64_t bits)
+            : _bits(bits) { }
+        constexpr int operator*() const { return std::countr_zero(_bits); }
+        constexpr Iterator& operator++() {
+            _bits &= _bits - 1;
+            return *this;
+        }
+        constexpr bool operator!=(const Iterator& other) const { return _bits != other._bits; }
+
+      private:
+        uint64_t _bits;
+    };
+    constexpr Iterator begin() const { return Iterator(_data); }
+    constexpr Iterator end() const { return Iterator(0); }
+
+    // every square one step in direction, anything that would wrap around to the other side of the board is dropped
+    template <Direction D>
+    constexpr BitboardElement shift() const {
+        return BitboardElement(shiftBy<D>(_data) & wrapMask<D>());
+    }
+
+    // kogge-stone occluded fill: the squares in this set together with everything they reach
+    // sliding in direction over the squares in empty
+    template <Direction D>
+    constexpr BitboardElement fill(uint64_t empty) const {
+        uint64_t gen = _data;
+        empty &= wrapMask<D>();
+        gen |= empty & shiftBy<D>(gen);
+        empty &= shiftBy<D>(empty);
+        gen |= empty & shiftBy<2 * D>(gen);
+        empty &= shiftBy<2 * D>(empty);
+        gen |= empty & shiftBy<4 * D>(gen);
+        return BitboardElement(gen);
+    }
+
+    // what sliders on this set attack in direction: the fill, one more step onto the blocker, and not themselves
+    template <Direction D>
+    constexpr BitboardElement slide(uint64_t empty) const {
+        return fill<D>(empty).template shift<D>();
+    }
+
     BitboardElement& operator|=(const uint64_t other) {
         _data |= other;
         return *this;
@@ -56,6 +127,12 @@ class BitboardElement {
         return *this;
     }
 
+    friend constexpr BitboardElement operator|(BitboardElement a, BitboardElement b) { return BitboardElement(a._data | b._data); }
+    friend constexpr BitboardElement operator&(BitboardElement a, BitboardElement b) { return BitboardElement(a._data & b._data); }
+    friend constexpr BitboardElement operator^(BitboardElement a, BitboardElement b) { return BitboardElement(a._data ^ b._data); }
+    constexpr BitboardElement operator~() const { return BitboardElement(~_data); }
+    constexpr bool operator==(const BitboardElement& other) const { return _data == other._data; }
+
     void printBitboard() {
         std::cout << "\n  a b c d e f g h\n";
         for (int rank = 7; rank >= 0; rank--) {
@@ -79,31 +156,92 @@ class BitboardElement {
 private:
     uint64_t    _data;
 
-    inline int bitScanForward(uint64_t bb) const {
-#if defined(_MSC_VER) && !defined(__clang__)
-        unsigned long index;
-        _BitScanForward64(&index, bb);
-        return index;
-#else
-        return __builtin_ffsll(bb) - 1;
-#endif
-    };
+    template <int Offset>
+    static constexpr uint64_t shiftBy(uint64_t bb) {
+        if constexpr (Offset > 0) {
+            return bb << Offset;
+        } else {
+            return bb >> -Offset;
+        }
+    }
+
+    // a step east lands on the a file only by wrapping around, a step west on the h file the same way
+    template <Direction D>
+    static constexpr uint64_t wrapMask() {
+        if constexpr (D == East || D == NorthEast || D == SouthEast) {
+            return ~FILE_A;
+        } else if constexpr (D == West || D == NorthWest || D == SouthWest) {
+            return ~FILE_H;
+        } else {
+            return ~0ULL;
+        }
+    }
+};
+
+static_assert(BitboardElement(FILE_H).shift<East>().empty() && BitboardElement(RANK_8).shift<North>().empty(), "shifts drop what leaves the board");
+static_assert(BitboardElement(1ULL).slide<NorthEast>(~0ULL).count() == 7, "a bishop on a1 sees the long diagonal");
+static_assert(BitboardElement(1ULL).slide<North>(~(1ULL << 24)).getData() == 0x0000000001010100ULL, "a rook on a1 stops on a4");
 
+// the low two bits of a promotion flag pick the piece, Knight + (flags & 3)
+enum MoveFlags
+{
+    QuietMove = 0,
+    DoublePawnPush = 1,
+    KingCastle = 2,
+    QueenCastle = 3,
+    Capture = 4,
+    EnPassantCapture = 5,
+    KnightPromotion = 8,
+    BishopPromotion = 9,
+    RookPromotion = 10,
+    QueenPromotion = 11,
+    KnightPromotionCapture = 12,
+    BishopPromotionCapture = 13,
+    RookPromotionCapture = 14,
+    QueenPromotionCapture = 15
 };
 
+// a move packed in 16 bits: from in bits 0-5, to in bits 6-11, MoveFlags in bits 12-15
 struct BitMove {
-    uint8_t from;
-    uint8_t to;
-    uint8_t piece;
-    
-    BitMove(int from, int to, ChessPiece piece)
-        : from(from), to(to), piece(piece) { }
-        
-    BitMove() : from(0), to(0), piece(NoPiece) { }
-    
-    bool operator==(const BitMove& other) const {
-        return from == other.from && 
-               to == other.to && 
-               piece == other.piece;
+    uint16_t data;
+
+    BitMove() = default;
+    constexpr BitMove(int from, int to, int flags = QuietMove)
+        : data((uint16_t)(from | (to << 6) | (flags << 12))) { }
+
+    constexpr int from() const { return data & 0x3F; }
+    constexpr int to() const { return (data >> 6) & 0x3F; }
+    constexpr int flags() const { return data >> 12; }
+
+    constexpr bool isCapture() const { return flags() & Capture; }
+    constexpr bool isPromotion() const { return flags() & KnightPromotion; }
+    constexpr bool isCastle() const { return flags() == KingCastle || flags() == QueenCastle; }
+    constexpr ChessPiece promotion() const { return (ChessPiece)(Knight + (flags() & 3)); }
+
+    constexpr bool operator==(const BitMove& other) const {
+        return data == other.data;
     }
-};
\ No newline at end of file
+};
+
+// a1 to a1 is never a real move, so it stands in for "no move"
+inline constexpr BitMove NoMove = BitMove(0, 0);
+
+// fixed capacity move list that lives on the stack, no legal position has more than 218 moves
+struct MoveList {
+    static constexpr int Capacity = 256;
+
+    BitMove moves[Capacity];
+    int count = 0;
+
+    void add(int from, int to, int flags = QuietMove) { moves[count++] = BitMove(from, to, flags); }
+    void clear() { count = 0; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    BitMove& operator[](int i) { return moves[i]; }
+    const BitMove& operator[](int i) const { return moves[i]; }
+    BitMove* begin() { return moves; }
+    BitMove* end() { return moves + count; }
+    const BitMove* begin() const { return moves; }
+    const BitMove* end() const { return moves + count; }
+};
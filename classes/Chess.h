@@ -1,15 +1,23 @@
 #pragma once
 
 #include "Bitboard.h"
+#include "ChessPosition.h"
+#include "ChessSearch.h"
 #include "Game.h"
 #include "Grid.h"
 
 constexpr int pieceSize = 80;
+// transposition table size when the game isn't given one, allocated when the AI first moves and given back by stopGame
+constexpr int defaultHashMegabytes = 32;
+// search depth when the game options don't ask for one, deeper keeps the frame waiting too long
+constexpr int defaultAIDepth = 6;
+// the search runs inside the frame, so this is how long the window can freeze on the AI's turn
+constexpr int aiMoveTimeMs = 2000;
 
 class Chess : public Game
 {
 public:
-    Chess();
+    Chess(int hashMegabytes = defaultHashMegabytes);
     ~Chess();
 
     void setUpBoard() override;
@@ -21,6 +29,10 @@ public:
 
     void endTurn() override;
 
+    // AI methods
+    void updateAI() override;
+    bool gameHasAI() override { return true; }
+
     void stopGame() override;
 
     Player *checkForWinner() override;
@@ -38,63 +50,24 @@ private:
     Player* ownerAt(int x, int y) const;
     char pieceNotation(int x, int y) const;
 
-    // things to do:
-    // set up bitboards for king, knight and pawns
-    // generate their moves
-    // 
-    void generateAllCurrentMoves(std::vector<BitMove>&, int);
-
-    void makeMove(int, int, ChessPiece, int);
-
-    // knight
-    void getKnightmoves();
-    void generateKnightmoves(std::vector<BitMove>&, BitboardElement, uint64_t);
-    std::vector<BitboardElement> _Knightmoves;
-
-    // King
-    void getKingmoves();
-    void generateKingmoves(std::vector<BitMove>&, BitboardElement, uint64_t, int);
-    std::vector<BitboardElement> _Kingmoves;
-
-    // pawns 
-    void getPawnmoves();
-    void generateWhitePawnmoves(std::vector<BitMove>&, BitboardElement, uint64_t, uint64_t);
-    void generateBlackPawnmoves(std::vector<BitMove>&, BitboardElement, uint64_t, uint64_t);
-    std::vector<BitboardElement> _WhitePawnmoves;
-    std::vector<BitboardElement> _BlackPawnmoves;
-
-    std::vector<BitMove> moves;
-
-    //board:
-    BitboardElement ChessBoard[12];
-    // let 0-5 be white and 6-11 be black
-
-    void ClearChessBoards();
-    int BoardIndex(ChessPiece, int);
-
-    //debug :)
-    void PrintChessBoards();
-
-    // Pawn helpers 
-    uint64_t horizontalNeighbors(uint64_t bb);
-    int enPassantSquare = -1;
-
-    // Castling
-    bool Kingsmoved[2] = {false, false};
-    /* Rook: 
-        queen side:
-            white: [0] aka player
-            black: [1]
-        king side: 
-            white: [2] aka player + 2
-            black: [3]
-    */
-    bool Rooksmoved[4] = {false, false, false, false};
-    uint64_t rankMask = 0x00000000000000FFULL;
-
-    // sides of the board
-    const uint64_t FILE_A = 0x0101010101010101ULL;
-    const uint64_t FILE_H = 0x8080808080808080ULL;
+    void makeMove(BitMove);
+    void generateMoves();
+    void syncView();
+
+    // the rules live in the position, this class only keeps the Grid in step with it
+    ChessPosition _position;
+    MoveList moves;
+    // kept for the whole game, so every search starts from what the last one learned
+    // Application drops finished games without deleting them, so stopGame frees it rather than the destructor
+    TranspositionTable _table;
+    int _hashMegabytes;
+    ChessSearch _search{ _table };
+    // the move the engine just picked, so a promotion comes out as the piece it chose
+    BitMove _aiMove = NoMove;
+    // the 12 boards as the Grid shows them right now, syncView diffs the position against these
+    uint64_t _viewBoards[12] = {};
+    // legal destinations per from square, one bit per square
+    uint64_t _legalDestinations[64] = {};
 
     Grid* _grid;
 };
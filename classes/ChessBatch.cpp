@@ -0,0 +1,326 @@
+#include "ChessBatch.h"
+#include <cstring>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BATCH_INLINE __attribute__((always_inline)) inline
+// gcc and clang vector extensions: plain operators on 2, 4 or 8 uint64_t at once,
+// the instructions they turn into are the ones the enclosing function is built for
+#define CHESS_BATCH_VECTORS 1
+typedef uint64_t Lanes2 __attribute__((vector_size(16)));
+typedef uint64_t Lanes4 __attribute__((vector_size(32)));
+typedef uint64_t Lanes8 __attribute__((vector_size(64)));
+#if defined(__x86_64__) || defined(__i386__)
+#define CHESS_BATCH_X86 1
+#endif
+// the helpers take and return avx vectors from functions built without avx, which gcc warns changes the abi;
+// they are all inlined into a kernel built for the right instruction set, so there is no call for it to change
+#pragma GCC diagnostic ignored "-Wpsabi"
+#elif defined(_MSC_VER)
+#define BATCH_INLINE __forceinline
+#else
+#define BATCH_INLINE inline
+#endif
+
+// BitboardElement has the same shifts and fills for a single uint64_t, these run on whole vectors of them
+static constexpr uint64_t FileA = FILE_A;
+static constexpr uint64_t FileB = FILE_A << 1;
+static constexpr uint64_t FileG = FILE_H >> 1;
+static constexpr uint64_t FileH = FILE_H;
+static constexpr uint64_t Rank3 = RANK_1 << 16;
+
+// the lane kernel is written once against V, which is a plain uint64_t or one of the vector types above
+
+// all ones in every lane where x is not zero
+BATCH_INLINE uint64_t nonZero(uint64_t x) { return 0ULL - (uint64_t)(x != 0); }
+#if defined(CHESS_BATCH_VECTORS)
+template <typename V>
+BATCH_INLINE V nonZero(const V& x) { return (V)(x != 0); }
+#endif
+
+template <typename V>
+BATCH_INLINE V load(const uint64_t* source) {
+    V v;
+    std::memcpy(&v, source, sizeof(V));
+    return v;
+}
+
+template <typename V>
+BATCH_INLINE void store(uint64_t* target, const V& v) {
+    std::memcpy(target, &v, sizeof(V));
+}
+
+// a step of Offset squares, up the board when positive
+template <int Offset, typename V>
+BATCH_INLINE V shift(const V& v) {
+    if constexpr (Offset > 0) {
+        return v << Offset;
+    } else {
+        return v >> -Offset;
+    }
+}
+
+// Wrap masks off the file a step east or west would have wrapped around onto
+template <int Offset, uint64_t Wrap, typename V>
+BATCH_INLINE V step(const V& v) {
+    return shift<Offset>(v) & Wrap;
+}
+
+// kogge-stone: every slider in gen runs along Offset over empty squares, then one more step onto the blocker
+template <int Offset, uint64_t Wrap, typename V>
+BATCH_INLINE V slide(const V& from, const V& over) {
+    V gen = from;
+    V empty = over & Wrap;
+    gen |= empty & shift<Offset>(gen);
+    empty &= shift<Offset>(empty);
+    gen |= empty & shift<2 * Offset>(gen);
+    empty &= shift<2 * Offset>(empty);
+    gen |= empty & shift<4 * Offset>(gen);
+    return step<Offset, Wrap>(gen);
+}
+
+template <typename V>
+BATCH_INLINE V kingSpread(const V& king) {
+    return step<8, ~0ULL>(king) | step<-8, ~0ULL>(king) | step<1, ~FileA>(king) | step<-1, ~FileH>(king)
+        | step<9, ~FileA>(king) | step<7, ~FileH>(king) | step<-7, ~FileA>(king) | step<-9, ~FileH>(king);
+}
+
+template <typename V>
+BATCH_INLINE V knightSpread(const V& knights) {
+    return step<17, ~FileA>(knights) | step<15, ~FileH>(knights) | step<10, ~(FileA | FileB)>(knights) | step<6, ~(FileG | FileH)>(knights)
+        | step<-6, ~(FileA | FileB)>(knights) | step<-10, ~(FileG | FileH)>(knights) | step<-15, ~FileA>(knights) | step<-17, ~FileH>(knights);
+}
+
+// what the king sees along one direction: a check from a slider there, or one of our pieces pinned against it
+template <int Offset, uint64_t Wrap, typename V>
+BATCH_INLINE void kingRay(const V& king, const V& empty, const V& own, const V& sliders, V& checkers, V& checkRays, V& pinned) {
+    V ray = slide<Offset, Wrap>(king, empty);
+    V hit = ray & sliders;
+    checkers |= hit;
+    checkRays |= ray & nonZero(hit);
+    V blocker = ray & own;
+    pinned |= blocker & nonZero(slide<Offset, Wrap>(blocker, empty) & sliders);
+}
+
+// one group of lanes, all of them white to move as far as the kernel can tell
+template <typename V>
+BATCH_INLINE void generateLanes(uint64_t* const* field, int first) {
+    V pieces[12];
+    for (int i = 0; i < 12; i++) {
+        pieces[i] = load<V>(field[i] + first);
+    }
+    V own = pieces[0] | pieces[1] | pieces[2] | pieces[3] | pieces[4] | pieces[5];
+    V enemy = pieces[6] | pieces[7] | pieces[8] | pieces[9] | pieces[10] | pieces[11];
+    V empty = ~(own | enemy);
+    V king = pieces[ChessBatch::OwnKing];
+    V enemyDiagonal = pieces[ChessBatch::EnemyBishops] | pieces[ChessBatch::EnemyQueens];
+    V enemyStraight = pieces[ChessBatch::EnemyRooks] | pieces[ChessBatch::EnemyQueens];
+
+    // everything the enemy attacks, looking through our king so it can't step back along a ray
+    V throughKing = empty | king;
+    V enemyPawns = pieces[ChessBatch::EnemyPawns];
+    V danger = step<-7, ~FileA>(enemyPawns) | step<-9, ~FileH>(enemyPawns)
+        | knightSpread(pieces[ChessBatch::EnemyKnights]) | kingSpread(pieces[ChessBatch::EnemyKing])
+        | slide<8, ~0ULL>(enemyStraight, throughKing) | slide<-8, ~0ULL>(enemyStraight, throughKing)
+        | slide<1, ~FileA>(enemyStraight, throughKing) | slide<-1, ~FileH>(enemyStraight, throughKing)
+        | slide<9, ~FileA>(enemyDiagonal, throughKing) | slide<-9, ~FileH>(enemyDiagonal, throughKing)
+        | slide<7, ~FileH>(enemyDiagonal, throughKing) | slide<-7, ~FileA>(enemyDiagonal, throughKing);
+
+    // checks and pins, walking out from the king; pins are kept per line since a pinned pawn may still move along it
+    V checkers = ((step<7, ~FileH>(king) | step<9, ~FileA>(king)) & enemyPawns) | (knightSpread(king) & pieces[ChessBatch::EnemyKnights]);
+    V checkRays{}, pinnedFile{}, pinnedRank{}, pinnedDiagonal{}, pinnedAntiDiagonal{};
+    kingRay<8, ~0ULL>(king, empty, own, enemyStraight, checkers, checkRays, pinnedFile);
+    kingRay<-8, ~0ULL>(king, empty, own, enemyStraight, checkers, checkRays, pinnedFile);
+    kingRay<1, ~FileA>(king, empty, own, enemyStraight, checkers, checkRays, pinnedRank);
+    kingRay<-1, ~FileH>(king, empty, own, enemyStraight, checkers, checkRays, pinnedRank);
+    kingRay<9, ~FileA>(king, empty, own, enemyDiagonal, checkers, checkRays, pinnedDiagonal);
+    kingRay<-9, ~FileH>(king, empty, own, enemyDiagonal, checkers, checkRays, pinnedDiagonal);
+    kingRay<7, ~FileH>(king, empty, own, enemyDiagonal, checkers, checkRays, pinnedAntiDiagonal);
+    kingRay<-7, ~FileA>(king, empty, own, enemyDiagonal, checkers, checkRays, pinnedAntiDiagonal);
+    V pinned = pinnedFile | pinnedRank | pinnedDiagonal | pinnedAntiDiagonal;
+
+    // not in check: anywhere, one checker: take it or block, double check: only the king moves
+    V checkMask = (~nonZero(checkers) | checkers | checkRays) & ~nonZero(checkers & (checkers - 1));
+    V targets = ~own & checkMask;
+
+    store(field[ChessBatch::OwnOccupancy] + first, own);
+    store(field[ChessBatch::EnemyOccupancy] + first, enemy);
+    store(field[ChessBatch::KingTargets] + first, kingSpread(king) & ~own & ~danger);
+
+    V knights = pieces[ChessBatch::OwnKnights] & ~pinned;
+    store(field[ChessBatch::KnightTargets + 0] + first, step<17, ~FileA>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 1] + first, step<15, ~FileH>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 2] + first, step<10, ~(FileA | FileB)>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 3] + first, step<6, ~(FileG | FileH)>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 4] + first, step<-6, ~(FileA | FileB)>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 5] + first, step<-10, ~(FileG | FileH)>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 6] + first, step<-15, ~FileA>(knights) & targets);
+    store(field[ChessBatch::KnightTargets + 7] + first, step<-17, ~FileH>(knights) & targets);
+
+    V pawns = pieces[ChessBatch::OwnPawns];
+    V singlePushes = step<8, ~0ULL>(pawns & ~(pinned ^ pinnedFile)) & empty;
+    store(field[ChessBatch::PawnPushes] + first, singlePushes & checkMask);
+    store(field[ChessBatch::PawnDoublePushes] + first, step<8, ~0ULL>(singlePushes & Rank3) & empty & checkMask);
+    store(field[ChessBatch::PawnWestCaptures] + first, step<7, ~FileH>(pawns & ~(pinned ^ pinnedAntiDiagonal)) & enemy & checkMask);
+    store(field[ChessBatch::PawnEastCaptures] + first, step<9, ~FileA>(pawns & ~(pinned ^ pinnedDiagonal)) & enemy & checkMask);
+}
+
+typedef void (*BatchKernel)(uint64_t* const*, int);
+
+#if !defined(CHESS_BATCH_VECTORS)
+static void generateScalar(uint64_t* const* field, int count) {
+    for (int first = 0; first < count; first++) {
+        generateLanes<uint64_t>(field, first);
+    }
+}
+#else
+static void generateVector(uint64_t* const* field, int count) {
+    for (int first = 0; first < count; first += 2) {
+        generateLanes<Lanes2>(field, first);
+    }
+}
+#endif
+
+#if defined(CHESS_BATCH_X86)
+__attribute__((target("avx2")))
+static void generateAvx2(uint64_t* const* field, int count) {
+    for (int first = 0; first < count; first += 4) {
+        generateLanes<Lanes4>(field, first);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void generateAvx512(uint64_t* const* field, int count) {
+    for (int first = 0; first < count; first += 8) {
+        generateLanes<Lanes8>(field, first);
+    }
+}
+#endif
+
+struct BatchBackend
+{
+    const char* name;
+    int lanes;
+    BatchKernel kernel;
+};
+
+// picked once, the first time anything asks
+static const BatchBackend& batchBackend() {
+    static const BatchBackend backend = [] {
+#if defined(CHESS_BATCH_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return BatchBackend { "avx512", 8, generateAvx512 };
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return BatchBackend { "avx2", 4, generateAvx2 };
+        }
+        return BatchBackend { "sse2", 2, generateVector };
+#elif defined(CHESS_BATCH_VECTORS)
+        return BatchBackend { "vector", 2, generateVector };
+#else
+        return BatchBackend { "scalar", 1, generateScalar };
+#endif
+    }();
+    return backend;
+}
+
+const char* ChessBatch::backend() {
+    return batchBackend().name;
+}
+
+int ChessBatch::lanes() {
+    return batchBackend().lanes;
+}
+
+void ChessBatch::clear() {
+    for (auto& field : _fields) {
+        field.clear();
+    }
+    _flipped.clear();
+    _count = 0;
+}
+
+static uint64_t flipRanks(uint64_t bb) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_uint64(bb);
+#else
+    return __builtin_bswap64(bb);
+#endif
+}
+
+void ChessBatch::add(const ChessPosition& position) {
+    // keep a whole group of padding lanes past the last position
+    if (_count % Padding == 0) {
+        for (auto& field : _fields) {
+            field.resize(_count + Padding, 0ULL);
+        }
+    }
+    int us = position.sideToMove();
+    for (int piece = Pawn; piece <= King; piece++) {
+        uint64_t ours = position.getBoard((ChessPiece) piece, us).getData();
+        uint64_t theirs = position.getBoard((ChessPiece) piece, us ^ 1).getData();
+        _fields[OwnPawns + piece - Pawn][_count] = us == White ? ours : flipRanks(ours);
+        _fields[EnemyPawns + piece - Pawn][_count] = us == White ? theirs : flipRanks(theirs);
+    }
+    _flipped.push_back(us == Black);
+    _count++;
+}
+
+void ChessBatch::generate() {
+    uint64_t* field[FieldCount];
+    for (int i = 0; i < FieldCount; i++) {
+        field[i] = _fields[i].data();
+    }
+    batchBackend().kernel(field, _count);
+}
+
+uint64_t ChessBatch::ownPieces(int lane) const {
+    uint64_t own = _fields[OwnOccupancy][lane];
+    return _flipped[lane] ? flipRanks(own) : own;
+}
+
+uint64_t ChessBatch::enemyPieces(int lane) const {
+    uint64_t enemy = _fields[EnemyOccupancy][lane];
+    return _flipped[lane] ? flipRanks(enemy) : enemy;
+}
+
+void ChessBatch::getMoves(int lane, MoveList& moves) const {
+    moves.clear();
+    // lanes turned around are put right again by flipping the rank of both squares
+    int flip = _flipped[lane] ? 56 : 0;
+    uint64_t enemy = _fields[EnemyOccupancy][lane];
+    auto addMoves = [&](uint64_t targets, int offset, int flags) {
+        BitboardElement(targets).forEachBit([&](int to) {
+            moves.add((to - offset) ^ flip, to ^ flip, flags | ((enemy >> to) & 1 ? Capture : QuietMove));
+        });
+    };
+    auto addPawnMoves = [&](uint64_t targets, int offset, int flags) {
+        BitboardElement(targets).forEachBit([&](int to) {
+            if (to < 56) {
+                moves.add((to - offset) ^ flip, to ^ flip, flags);
+                return;
+            }
+            // queen first, like ChessPosition
+            for (int promotion = 3; promotion >= 0; promotion--) {
+                moves.add((to - offset) ^ flip, to ^ flip, flags | KnightPromotion | promotion);
+            }
+        });
+    };
+
+    static constexpr int KnightOffsets[8] = { 17, 15, 10, 6, -6, -10, -15, -17 };
+    for (int direction = 0; direction < 8; direction++) {
+        addMoves(_fields[KnightTargets + direction][lane], KnightOffsets[direction], QuietMove);
+    }
+    addPawnMoves(_fields[PawnPushes][lane], 8, QuietMove);
+    addPawnMoves(_fields[PawnDoublePushes][lane], 16, DoublePawnPush);
+    addPawnMoves(_fields[PawnWestCaptures][lane], 7, Capture);
+    addPawnMoves(_fields[PawnEastCaptures][lane], 9, Capture);
+
+    uint64_t king = _fields[OwnKing][lane];
+    if (king) {
+        int from = BitboardElement(king).lsb() ^ flip;
+        BitboardElement(_fields[KingTargets][lane]).forEachBit([&](int to) {
+            moves.add(from, to ^ flip, (enemy >> to) & 1 ? Capture : QuietMove);
+        });
+    }
+}
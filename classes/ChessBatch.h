@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ChessPosition.h"
+#include <vector>
+
+//
+// move generation for many independent positions at once, for batch analysis and training data
+// the boards are kept lane by lane (structure of arrays) and every lane is turned so its side to move plays
+// up the board, so one vector instruction works on 2, 4 or 8 positions no matter who is to move in them
+//
+// covers the legal pawn (no en passant), knight and king (no castling) moves, checks and pins included,
+// exactly the ones generateAllCurrentMoves gives for those pieces; sliders, castling and en passant stay with ChessPosition
+//
+class ChessBatch
+{
+public:
+    void clear();
+    void add(const ChessPosition& position);
+    int size() const { return _count; }
+
+    // runs every lane through the widest kernel this cpu has
+    void generate();
+    // lane's moves once generate() ran, on the real board
+    void getMoves(int lane, MoveList& moves) const;
+    // the squares the side to move's and the other side's pieces stand on
+    uint64_t ownPieces(int lane) const;
+    uint64_t enemyPieces(int lane) const;
+
+    // "avx512", "avx2", "sse2", "vector" or "scalar", and how many positions it handles per instruction
+    static const char* backend();
+    static int lanes();
+
+    // every field is an array with one entry per lane, padded so the widest kernel never reads past the end
+    enum Field
+    {
+        // our pieces then theirs, Pawn - 1 to King - 1
+        OwnPawns, OwnKnights, OwnBishops, OwnRooks, OwnQueens, OwnKing,
+        EnemyPawns, EnemyKnights, EnemyBishops, EnemyRooks, EnemyQueens, EnemyKing,
+        // what generate() fills in, targets of one kind of move each so the from square is to - offset
+        OwnOccupancy, EnemyOccupancy,
+        PawnPushes, PawnDoublePushes, PawnWestCaptures, PawnEastCaptures,
+        KingTargets,
+        KnightTargets, // one per knight direction, KnightTargets + 0 to 7
+        FieldCount = KnightTargets + 8
+    };
+
+private:
+    static constexpr int Padding = 8;
+
+    std::vector<uint64_t> _fields[FieldCount];
+    // which lanes were turned around because black is to move
+    std::vector<uint8_t> _flipped;
+    int _count = 0;
+};
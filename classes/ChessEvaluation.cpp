@@ -0,0 +1,446 @@
+#include "ChessEvaluation.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// piece square tables, written the way white sees the board (rank 8 on top)
+// so white looks up square ^ 56 and black looks up square as is
+static constexpr int PawnTable[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+     50,  50,  50,  50,  50,  50,  50,  50,
+     10,  10,  20,  30,  30,  20,  10,  10,
+      5,   5,  10,  25,  25,  10,   5,   5,
+      0,   0,   0,  20,  20,   0,   0,   0,
+      5,  -5, -10,   0,   0, -10,  -5,   5,
+      5,  10,  10, -20, -20,  10,  10,   5,
+      0,   0,   0,   0,   0,   0,   0,   0
+};
+
+static constexpr int KnightTable[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50,
+    -40, -20,   0,   0,   0,   0, -20, -40,
+    -30,   0,  10,  15,  15,  10,   0, -30,
+    -30,   5,  15,  20,  20,  15,   5, -30,
+    -30,   0,  15,  20,  20,  15,   0, -30,
+    -30,   5,  10,  15,  15,  10,   5, -30,
+    -40, -20,   0,   5,   5,   0, -20, -40,
+    -50, -40, -30, -30, -30, -30, -40, -50
+};
+
+static constexpr int BishopTable[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,  10,  10,   5,   0, -10,
+    -10,   5,   5,  10,  10,   5,   5, -10,
+    -10,   0,  10,  10,  10,  10,   0, -10,
+    -10,  10,  10,  10,  10,  10,  10, -10,
+    -10,   5,   0,   0,   0,   0,   5, -10,
+    -20, -10, -10, -10, -10, -10, -10, -20
+};
+
+static constexpr int RookTable[64] = {
+      0,   0,   0,   0,   0,   0,   0,   0,
+      5,  10,  10,  10,  10,  10,  10,   5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+     -5,   0,   0,   0,   0,   0,   0,  -5,
+      0,   0,   0,   5,   5,   0,   0,   0
+};
+
+static constexpr int QueenTable[64] = {
+    -20, -10, -10,  -5,  -5, -10, -10, -20,
+    -10,   0,   0,   0,   0,   0,   0, -10,
+    -10,   0,   5,   5,   5,   5,   0, -10,
+     -5,   0,   5,   5,   5,   5,   0,  -5,
+      0,   0,   5,   5,   5,   5,   0,  -5,
+    -10,   5,   5,   5,   5,   5,   0, -10,
+    -10,   0,   5,   0,   0,   0,   0, -10,
+    -20, -10, -10,  -5,  -5, -10, -10, -20
+};
+
+// the king hides behind its pawns while there is material to attack it, and walks to the center once there isn't
+static constexpr int KingMiddleTable[64] = {
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -30, -40, -40, -50, -50, -40, -40, -30,
+    -20, -30, -30, -40, -40, -30, -30, -20,
+    -10, -20, -20, -20, -20, -20, -20, -10,
+     20,  20,   0,   0,   0,   0,  20,  20,
+     20,  30,  10,   0,   0,  10,  30,  20
+};
+
+static constexpr int KingEndTable[64] = {
+    -50, -40, -30, -20, -20, -30, -40, -50,
+    -30, -20, -10,   0,   0, -10, -20, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  30,  40,  40,  30, -10, -30,
+    -30, -10,  20,  30,  30,  20, -10, -30,
+    -30, -30,   0,   0,   0,   0, -30, -30,
+    -50, -30, -30, -30, -30, -30, -30, -50
+};
+
+static constexpr const int* PieceTables[7] = { nullptr, PawnTable, KnightTable, BishopTable, RookTable, QueenTable, nullptr };
+
+// game phase from the pieces left, 24 with everything on the board down to 0 with only kings and pawns
+static constexpr int PhaseWeight[7] = { 0, 0, 1, 1, 2, 4, 0 };
+static constexpr int MaxPhase = 24;
+
+// endgame scaling factors, the general score is multiplied by scale / ScaleNormal
+static constexpr int ScaleNormal = 64;
+
+static int fileOf(int square) { return square & 7; }
+static int rankOf(int square) { return square >> 3; }
+static int distance(int a, int b) {
+    return std::max(std::abs(fileOf(a) - fileOf(b)), std::abs(rankOf(a) - rankOf(b)));
+}
+// -1 when that king is gone, a fen can leave one out and the search can capture one after an illegal fen
+static int kingSquare(const ChessPosition& position, int player) {
+    const BitboardElement& king = position.getBoard(King, player);
+    return king.empty() ? -1 : king.lsb();
+}
+static bool isDarkSquare(int square) {
+    return ((fileOf(square) + rankOf(square)) & 1) == 0;
+}
+
+// the losing king is driven to the edge and the winning one follows it
+static int pushToEdge(int square) {
+    int file = std::max(3 - fileOf(square), fileOf(square) - 4);
+    int rank = std::max(3 - rankOf(square), rankOf(square) - 4);
+    return 10 * (file + rank);
+}
+static int pushClose(int a, int b) {
+    return 10 * (7 - distance(a, b));
+}
+
+//
+// KPK bitbase
+// white has the pawn, always on files a-d (the rest mirror onto them) and ranks 2-7
+// one bit per (side to move, black king, white king, pawn), built by retrograde analysis the first time it is asked
+//
+static constexpr int KPKSize = 2 * 64 * 64 * 24;
+static uint64_t KPKWins[KPKSize / 64];
+
+static int kpkIndex(int sideToMove, int blackKing, int whiteKing, int pawn) {
+    int pawnIndex = fileOf(pawn) + 4 * (rankOf(pawn) - 1);
+    return sideToMove | (blackKing << 1) | (whiteKing << 7) | (pawnIndex << 13);
+}
+
+enum KPKResult : uint8_t
+{
+    KPKInvalid = 0,
+    KPKUnknown = 1,
+    KPKDraw = 2,
+    KPKWin = 4
+};
+
+static bool whitePawnAttacks(int pawn, int square) {
+    return rankOf(square) == rankOf(pawn) + 1 && std::abs(fileOf(square) - fileOf(pawn)) == 1;
+}
+
+// calls func for every square a king on square can step to
+template <typename Func>
+static void forEachKingStep(int square, Func func) {
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int x = fileOf(square) + dx;
+            int y = rankOf(square) + dy;
+            if ((dx || dy) && x >= 0 && x < 8 && y >= 0 && y < 8) {
+                func(y * 8 + x);
+            }
+        }
+    }
+}
+
+// what the position is worth before looking at any move: illegal, won or drawn on the spot, or unknown
+static KPKResult kpkInitial(int sideToMove, int blackKing, int whiteKing, int pawn) {
+    if (whiteKing == blackKing || whiteKing == pawn || blackKing == pawn || distance(whiteKing, blackKing) <= 1
+        || (sideToMove == White && whitePawnAttacks(pawn, blackKing))) {
+        return KPKInvalid;
+    }
+    int promotion = pawn + 8;
+    if (sideToMove == White && rankOf(pawn) == 6 && whiteKing != promotion && blackKing != promotion
+        && (distance(blackKing, promotion) > 1 || distance(whiteKing, promotion) == 1)) {
+        return KPKWin;
+    }
+    if (sideToMove == Black) {
+        // the pawn falls
+        if (distance(blackKing, pawn) == 1 && distance(whiteKing, pawn) > 1) {
+            return KPKDraw;
+        }
+        // stalemate
+        bool canMove = false;
+        forEachKingStep(blackKing, [&](int to) {
+            canMove |= distance(to, whiteKing) > 1 && !whitePawnAttacks(pawn, to);
+        });
+        if (!canMove) {
+            return KPKDraw;
+        }
+    }
+    return KPKUnknown;
+}
+
+static bool buildKPK() {
+    std::vector<uint8_t> results(KPKSize);
+    for (int index = 0; index < KPKSize; index++) {
+        int pawnIndex = index >> 13;
+        int pawn = (pawnIndex & 3) + 8 * (pawnIndex / 4 + 1);
+        results[index] = kpkInitial(index & 1, (index >> 1) & 63, (index >> 7) & 63, pawn);
+    }
+
+    // keep resolving unknowns from their successors until nothing changes
+    // white wins if any move wins, black draws if any move draws
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int index = 0; index < KPKSize; index++) {
+            if (results[index] != KPKUnknown) {
+                continue;
+            }
+            int sideToMove = index & 1;
+            int blackKing = (index >> 1) & 63;
+            int whiteKing = (index >> 7) & 63;
+            int pawnIndex = index >> 13;
+            int pawn = (pawnIndex & 3) + 8 * (pawnIndex / 4 + 1);
+
+            int reached = 0;
+            if (sideToMove == White) {
+                forEachKingStep(whiteKing, [&](int to) {
+                    reached |= results[kpkIndex(Black, blackKing, to, pawn)];
+                });
+                if (rankOf(pawn) < 6) {
+                    reached |= results[kpkIndex(Black, blackKing, whiteKing, pawn + 8)];
+                }
+                if (rankOf(pawn) == 1 && pawn + 8 != whiteKing && pawn + 8 != blackKing) {
+                    reached |= results[kpkIndex(Black, blackKing, whiteKing, pawn + 16)];
+                }
+            } else {
+                forEachKingStep(blackKing, [&](int to) {
+                    reached |= results[kpkIndex(White, to, whiteKing, pawn)];
+                });
+            }
+
+            uint8_t result;
+            if (sideToMove == White) {
+                result = (reached & KPKWin) ? KPKWin : (reached & KPKUnknown) ? KPKUnknown : KPKDraw;
+            } else {
+                result = (reached & KPKDraw) ? KPKDraw : (reached & KPKUnknown) ? KPKUnknown : KPKWin;
+            }
+            if (result != KPKUnknown) {
+                results[index] = result;
+                changed = true;
+            }
+        }
+    }
+
+    for (int index = 0; index < KPKSize; index++) {
+        if (results[index] == KPKWin) {
+            KPKWins[index >> 6] |= 1ULL << (index & 63);
+        }
+    }
+    return true;
+}
+
+bool kpkWins(int strongKing, int strongPawn, int weakKing, int strongSide, int sideToMove) {
+    [[maybe_unused]] static const bool built = buildKPK();
+    // turn the board so the pawn is white and on the queen side
+    if (strongSide == Black) {
+        strongKing ^= 56;
+        strongPawn ^= 56;
+        weakKing ^= 56;
+        sideToMove ^= 1;
+    }
+    if (fileOf(strongPawn) >= 4) {
+        strongKing ^= 7;
+        strongPawn ^= 7;
+        weakKing ^= 7;
+    }
+    int index = kpkIndex(sideToMove, weakKing, strongKing, strongPawn);
+    return KPKWins[index >> 6] & (1ULL << (index & 63));
+}
+
+//
+// endgame evaluators, each one scores for strongSide and is only ever called on the material it was registered for
+//
+
+// nothing left to mate with
+static int evaluateDraw(const ChessPosition& position, int strongSide) {
+    return 0;
+}
+
+// KQK, KRK: drive the lone king to the edge with the other king helping
+static int evaluateKXK(const ChessPosition& position, int strongSide) {
+    int winner = kingSquare(position, strongSide);
+    int loser = kingSquare(position, strongSide ^ 1);
+    if (winner < 0 || loser < 0) {
+        return 0;
+    }
+    int material = position.pieceCount(Queen, strongSide) * PieceValues[Queen] + position.pieceCount(Rook, strongSide) * PieceValues[Rook];
+    return KnownWin + material + pushToEdge(loser) + pushClose(winner, loser);
+}
+
+// KBNK: only the two corners of the bishop's color can be mated in, so the lone king goes to the nearer of those
+static int evaluateKBNK(const ChessPosition& position, int strongSide) {
+    int winner = kingSquare(position, strongSide);
+    int loser = kingSquare(position, strongSide ^ 1);
+    if (winner < 0 || loser < 0) {
+        return 0;
+    }
+    int bishop = position.getBoard(Bishop, strongSide).lsb();
+    int corner = isDarkSquare(bishop) ? std::min(distance(loser, 0), distance(loser, 63)) : std::min(distance(loser, 7), distance(loser, 56));
+    return KnownWin + PieceValues[Knight] + PieceValues[Bishop] + 20 * (7 - corner) + pushClose(winner, loser);
+}
+
+// KPK: exact from the bitbase, a won one gets better the further the pawn has come
+static int evaluateKPK(const ChessPosition& position, int strongSide) {
+    int winner = kingSquare(position, strongSide);
+    int loser = kingSquare(position, strongSide ^ 1);
+    if (winner < 0 || loser < 0) {
+        return 0;
+    }
+    int pawn = position.getBoard(Pawn, strongSide).lsb();
+    if (!kpkWins(winner, pawn, loser, strongSide, position.sideToMove())) {
+        return 0;
+    }
+    int advanced = strongSide == White ? rankOf(pawn) : 7 - rankOf(pawn);
+    return KnownWin + PieceValues[Pawn] + 20 * advanced;
+}
+
+// bishops on opposite colors with only pawns beside them: an extra pawn or two rarely wins
+static int scaleOppositeBishops(const ChessPosition& position) {
+    int whiteBishop = position.getBoard(Bishop, White).lsb();
+    int blackBishop = position.getBoard(Bishop, Black).lsb();
+    if (isDarkSquare(whiteBishop) == isDarkSquare(blackBishop)) {
+        return ScaleNormal;
+    }
+    int pawnDifference = std::abs(position.pieceCount(Pawn, White) - position.pieceCount(Pawn, Black));
+    return pawnDifference <= 2 ? ScaleNormal / 4 : ScaleNormal / 2;
+}
+
+using EndgameEvaluator = int (*)(const ChessPosition&, int);
+using EndgameScaler = int (*)(const ChessPosition&);
+
+struct EndgameEntry
+{
+    uint64_t key = 0ULL;
+    EndgameEvaluator evaluate = nullptr;
+    EndgameScaler scale = nullptr;
+    int strongSide = White;
+};
+
+//
+// the endgame table: material key -> evaluator or scaling function
+// open addressing on the low bits of the key, a couple of hundred entries in 512 slots
+//
+class EndgameTable
+{
+public:
+    EndgameTable() {
+        addEvaluator("KvK", evaluateDraw);
+        addEvaluator("KNvK", evaluateDraw);
+        addEvaluator("KBvK", evaluateDraw);
+        addEvaluator("KNNvK", evaluateDraw);
+        addEvaluator("KQvK", evaluateKXK);
+        addEvaluator("KRvK", evaluateKXK);
+        addEvaluator("KBNvK", evaluateKBNK);
+        addEvaluator("KPvK", evaluateKPK);
+        for (int whitePawns = 0; whitePawns <= 8; whitePawns++) {
+            for (int blackPawns = 0; blackPawns <= 8; blackPawns++) {
+                addScaler("KB" + std::string(whitePawns, 'P') + "vKB" + std::string(blackPawns, 'P'), scaleOppositeBishops);
+            }
+        }
+    }
+
+    const EndgameEntry* probe(uint64_t key) const {
+        for (int slot = key & (Slots - 1); _entries[slot].key; slot = (slot + 1) & (Slots - 1)) {
+            if (_entries[slot].key == key) {
+                return &_entries[slot];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    static constexpr int Slots = 512;
+    EndgameEntry _entries[Slots];
+
+    // "KBNvK" is king, bishop and knight against a lone king, the first side is the strong one
+    static uint64_t keyFor(const std::string& code, int strongSide) {
+        int counts[12] = {};
+        int player = strongSide;
+        for (char c : code) {
+            if (c == 'v') {
+                player ^= 1;
+                continue;
+            }
+            ChessPiece piece = c == 'P' ? Pawn : c == 'N' ? Knight : c == 'B' ? Bishop : c == 'R' ? Rook : c == 'Q' ? Queen : King;
+            counts[ChessPosition::BoardIndex(piece, player)]++;
+        }
+        return ChessPosition::materialKey(counts);
+    }
+
+    void insert(const EndgameEntry& entry) {
+        int slot = entry.key & (Slots - 1);
+        while (_entries[slot].key && _entries[slot].key != entry.key) {
+            slot = (slot + 1) & (Slots - 1);
+        }
+        _entries[slot] = entry;
+    }
+
+    // registered for white and black being the strong side, symmetric material ends up in one slot
+    void addEvaluator(const std::string& code, EndgameEvaluator evaluate) {
+        insert({ keyFor(code, Black), evaluate, nullptr, Black });
+        insert({ keyFor(code, White), evaluate, nullptr, White });
+    }
+
+    void addScaler(const std::string& code, EndgameScaler scale) {
+        insert({ keyFor(code, White), nullptr, scale, White });
+    }
+};
+
+static const EndgameTable& endgames() {
+    static const EndgameTable table;
+    return table;
+}
+
+int evaluate(const ChessPosition& position) {
+    int us = position.sideToMove();
+    const EndgameEntry* endgame = endgames().probe(position.getMaterialKey());
+    if (endgame && endgame->evaluate) {
+        int score = endgame->evaluate(position, endgame->strongSide);
+        return endgame->strongSide == us ? score : -score;
+    }
+
+    int phase = 0;
+    for (int piece = Knight; piece <= Queen; piece++) {
+        phase += PhaseWeight[piece] * (position.pieceCount((ChessPiece) piece, White) + position.pieceCount((ChessPiece) piece, Black));
+    }
+    phase = std::min(phase, MaxPhase);
+
+    // from white's point of view
+    int score = 0;
+    for (int player = 0; player < 2; player++) {
+        int sign = player == White ? 1 : -1;
+        int flip = player == White ? 56 : 0;
+        for (int piece = Pawn; piece <= Queen; piece++) {
+            const int* table = PieceTables[piece];
+            position.getBoard((ChessPiece) piece, player).forEachBit([&](int square) {
+                score += sign * (PieceValues[piece] + table[square ^ flip]);
+            });
+        }
+        int king = kingSquare(position, player);
+        if (king >= 0) {
+            king ^= flip;
+            score += sign * (KingMiddleTable[king] * phase + KingEndTable[king] * (MaxPhase - phase)) / MaxPhase;
+        }
+    }
+
+    if (endgame && endgame->scale) {
+        score = score * endgame->scale(position) / ScaleNormal;
+    }
+    return us == White ? score : -score;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ChessPosition.h"
+
+// scores are centipawns from the side to move's point of view
+// a won endgame scores past KnownWin, which stays well below anything a search uses for mate
+inline constexpr int KnownWin = 10000;
+
+// static evaluation of a position
+// material the endgame table knows (KBNK, KRK, KPK, ...) gets its own evaluator and the general one is skipped,
+// everything else is material plus piece square tables, scaled down when the table says the ending is drawish
+int evaluate(const ChessPosition& position);
+
+// the KPK bitbase: does the side with the pawn win, given the squares and who is to move
+bool kpkWins(int strongKing, int strongPawn, int weakKing, int strongSide, int sideToMove);
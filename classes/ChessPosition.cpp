@@ -0,0 +1,1314 @@
+#include "ChessPosition.h"
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// leaper tables, built by the compiler and shared by every position
+// steps are { dx, dy }, anything that would leave the board is dropped
+template <size_t N>
+static constexpr std::array<uint64_t, 64> leaperAttacks(const int (&steps)[N][2]) {
+    std::array<uint64_t, 64> table{};
+    for (int sq = 0; sq < 64; sq++) {
+        int x = sq % 8;
+        int y = sq / 8;
+        for (const auto& step : steps) {
+            int newX = x + step[0];
+            int newY = y + step[1];
+            if (newX >= 0 && newX < 8 && newY >= 0 && newY < 8) {
+                table[sq] |= 1ULL << (newY * 8 + newX);
+            }
+        }
+    }
+    return table;
+}
+
+static constexpr int KnightSteps[8][2] = { {2, 1}, {1, 2}, {-1, 2}, {-1, -2}, {1, -2}, {2, -1}, {-2, -1}, {-2, 1} };
+static constexpr int KingSteps[8][2] = { {1, 1}, {1, 0}, {-1, 1}, {-1, 0}, {1, -1}, {0, -1}, {-1, -1}, {0, 1} };
+static constexpr int WhitePawnSteps[2][2] = { {-1, 1}, {1, 1} };
+static constexpr int BlackPawnSteps[2][2] = { {-1, -1}, {1, -1} };
+
+static constexpr std::array<uint64_t, 64> KnightAttacks = leaperAttacks(KnightSteps);
+static constexpr std::array<uint64_t, 64> KingAttacks = leaperAttacks(KingSteps);
+// squares a pawn of each color on sq attacks, [player][sq]
+static constexpr std::array<uint64_t, 64> PawnAttacks[2] = { leaperAttacks(WhitePawnSteps), leaperAttacks(BlackPawnSteps) };
+
+static_assert(KnightAttacks[0] == 0x0000000000020400ULL, "knight on a1 reaches b3 and c2");
+static_assert(KingAttacks[63] == 0x40C0000000000000ULL, "king on h8 reaches g8, g7 and h7");
+static_assert(PawnAttacks[0][8] == 0x0000000000020000ULL && PawnAttacks[1][55] == 0x0000400000000000ULL, "pawns on the edge attack one square");
+
+// castling rights that survive a move from or to each square
+static constexpr std::array<uint8_t, 64> CastlingRightsMask = [] {
+    std::array<uint8_t, 64> mask{};
+    mask.fill(AllCastling);
+    mask[0]  = (uint8_t) ~WhiteQueenSide;
+    mask[7]  = (uint8_t) ~WhiteKingSide;
+    mask[4]  = (uint8_t) ~(WhiteKingSide | WhiteQueenSide);
+    mask[56] = (uint8_t) ~BlackQueenSide;
+    mask[63] = (uint8_t) ~BlackKingSide;
+    mask[60] = (uint8_t) ~(BlackKingSide | BlackQueenSide);
+    return mask;
+}();
+
+ChessPosition::ChessPosition()
+{
+    ensureTables();
+    ClearChessBoards();
+}
+
+// the move tables are shared by every position, whoever needs them first fills them
+void ChessPosition::ensureTables() {
+    [[maybe_unused]] static const bool tablesBuilt = initTables();
+}
+
+// zobrist keys: piece on square, castling rights, en passant file and side to move
+static uint64_t ZobristPieces[12][64];
+static uint64_t ZobristCastling[16];
+static uint64_t ZobristEnPassant[8];
+static uint64_t ZobristSide;
+// [board][n] is in the material key while that board holds more than n pieces, loadFEN keeps the counts below 16
+static uint64_t ZobristMaterial[12][16];
+
+void ChessPosition::getZobristkeys() {
+    // fixed seed, so a position hashes the same every run
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    auto random64 = [&seed]() {
+        // xorshift64*
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        return seed * 0x2545F4914F6CDD1DULL;
+    };
+
+    for (int i = 0; i < 12; i++) {
+        for (int sq = 0; sq < 64; sq++) {
+            ZobristPieces[i][sq] = random64();
+        }
+    }
+    for (int i = 0; i < 16; i++) {
+        ZobristCastling[i] = random64();
+    }
+    for (int i = 0; i < 8; i++) {
+        ZobristEnPassant[i] = random64();
+    }
+    ZobristSide = random64();
+    for (int i = 0; i < 12; i++) {
+        for (int n = 0; n < 16; n++) {
+            ZobristMaterial[i][n] = random64();
+        }
+    }
+}
+
+// the hash from scratch, makeMove keeps it up to date incrementally after this
+uint64_t ChessPosition::computeHash() const {
+    uint64_t hash = 0ULL;
+    for (int sq = 0; sq < 64; sq++) {
+        if (_pieceOn[sq]) {
+            hash ^= ZobristPieces[BoardIndex(pieceTypeOn(sq), ownerOn(sq))][sq];
+        }
+    }
+    hash ^= ZobristCastling[_castlingRights];
+    if (enPassantSquare != -1) {
+        hash ^= ZobristEnPassant[enPassantSquare % 8];
+    }
+    if (_sideToMove == 1) {
+        hash ^= ZobristSide;
+    }
+    return hash;
+}
+
+uint64_t ChessPosition::materialKey(const int counts[12]) {
+    ensureTables();
+    uint64_t key = 0ULL;
+    for (int i = 0; i < 12; i++) {
+        for (int n = 0; n < counts[i]; n++) {
+            key ^= ZobristMaterial[i][n];
+        }
+    }
+    return key;
+}
+
+uint64_t ChessPosition::computeMaterialKey() const {
+    int counts[12];
+    for (int i = 0; i < 12; i++) {
+        counts[i] = ChessBoard[i].count();
+    }
+    return materialKey(counts);
+}
+
+bool ChessPosition::initTables()
+{
+    pickSliderBackend();
+    getBishopmoves();
+    getRookmoves();
+    getLinemasks();
+    getZobristkeys();
+    return true;
+}
+
+bool ChessPosition::loadFEN(const std::string& fen) {
+    int index = 0;
+    ChessPiece piece = NoPiece;
+    int player;
+    // a broken fen leaves an empty board behind rather than a half filled one
+    auto reject = [this]() {
+        ClearChessBoards();
+        enPassantSquare = -1;
+        _castlingRights = NoCastling;
+        _hash = computeHash();
+        _materialKey = computeMaterialKey();
+        if (_incremental) {
+            refreshAttacks(~0ULL);
+        }
+        return false;
+    };
+
+    ClearChessBoards();
+
+    std::string placement = fen;
+    std::string castling_rights = "KQkq";
+    std::string en_passant_rights = "-";
+    _sideToMove = 0;
+    _halfmoveClock = 0;
+    _fullmoveNumber = 1;
+    _undoCount = 0;
+    _legalityValid = false;
+
+    if (fen.find(' ') != std::string::npos) {
+        size_t first_space = fen.find(' ');
+        placement = fen.substr(0, first_space);
+
+        std::istringstream iss(fen.substr(first_space + 1));
+        std::string turn, castling, enpassant, halfmove, fullmove;
+
+        iss >> turn >> castling >> enpassant >> halfmove >> fullmove;
+
+        // active player
+        _sideToMove = (turn == "b") ? 1 : 0;
+        // castling rights
+        castling_rights = castling.empty() ? "-" : castling;
+        // en passant
+        en_passant_rights = enpassant.empty() ? "-" : enpassant;
+        // move clocks
+        if (!halfmove.empty()) _halfmoveClock = std::atoi(halfmove.c_str());
+        if (!fullmove.empty()) _fullmoveNumber = std::max(1, std::atoi(fullmove.c_str()));
+    }
+
+    for (char f : placement) {
+        if (f == '/') {
+            continue;
+        }
+
+        // how many empty spaces
+        if (isdigit(f)) {
+            index += f - '0';
+            if (index > 64) {
+                return reject();
+            }
+            continue;
+        }
+        if (index >= 64) {
+            return reject();
+        }
+
+        int square = index ^ 56; // flip board to start from whites POV
+
+        // what is the color
+        player = isupper(f) ? 0 : 1;
+        // what is the piece
+        switch (toupper(f)) {
+            case 'R':
+                piece = ChessPiece::Rook;
+                break;
+            case 'B':
+                piece = ChessPiece::Bishop;
+                break;
+            case 'N':
+                piece = ChessPiece::Knight;
+                break;
+            case 'Q':
+                piece = ChessPiece::Queen;
+                break;
+            case 'K':
+                piece = ChessPiece::King;
+                break;
+            case 'P':
+                piece = ChessPiece::Pawn;
+                break;
+            default:
+                return reject();
+        }
+
+        // set bit boards
+        ChessBoard[BoardIndex(piece, player)] |= 1ULL << square;
+        _pieceOn[square] = PieceCode(piece, player);
+
+        // next index on the board
+        index += 1;
+    }
+
+    // the material key has a slot for up to 16 of one kind, which a real game can never pass:
+    // at most 8 pawns and 16 pieces a side, promotions only trade one for the other
+    for (int side = 0; side < 2; side++) {
+        if (pieceCount(Pawn, side) > 8 || BitboardElement(getPieces(side)).count() > 16) {
+            return reject();
+        }
+    }
+
+    // one king each, and the side that just moved can't have left its own in check
+    if (pieceCount(King, White) != 1 || pieceCount(King, Black) != 1) {
+        return reject();
+    }
+    int otherKing = getBoard(King, _sideToMove ^ 1).lsb();
+    if (attackersTo(otherKing, getOccupancy()) & getPieces(_sideToMove)) {
+        return reject();
+    }
+
+    // castling
+    _castlingRights = NoCastling;
+    for (char c : castling_rights) {
+        switch (c) {
+            case 'K': _castlingRights |= WhiteKingSide; break;
+            case 'Q': _castlingRights |= WhiteQueenSide; break;
+            case 'k': _castlingRights |= BlackKingSide; break;
+            case 'q': _castlingRights |= BlackQueenSide; break;
+            default: break;
+        }
+    }
+
+    // en passant
+    enPassantSquare = -1;
+    if (en_passant_rights != "-") {
+        // only a square a pawn just skipped over, rank 3 behind a white push or rank 6 behind a black one
+        if (en_passant_rights.size() != 2 || en_passant_rights[0] < 'a' || en_passant_rights[0] > 'h'
+            || (en_passant_rights[1] != '3' && en_passant_rights[1] != '6')) {
+            return reject();
+        }
+        enPassantSquare = (en_passant_rights[1] - '1') * 8 + (en_passant_rights[0] - 'a');
+        // and only when the other side's pawn really just made that push: it stands one step past the square,
+        // and both the square and the one it started from are empty; anything else can't be captured, drop it
+        int pushed = (_sideToMove == White) ? 8 : -8;
+        int pawnSquare = enPassantSquare - pushed;
+        int startSquare = enPassantSquare + pushed;
+        bool rankFits = (_sideToMove == White) ? en_passant_rights[1] == '6' : en_passant_rights[1] == '3';
+        if (!rankFits || _pieceOn[pawnSquare] != PieceCode(Pawn, _sideToMove ^ 1) || _pieceOn[enPassantSquare] || _pieceOn[startSquare]) {
+            enPassantSquare = -1;
+        }
+    }
+
+    _hash = computeHash();
+    _materialKey = computeMaterialKey();
+    if (_incremental) {
+        refreshAttacks(~0ULL);
+    }
+    return true;
+}
+
+// splits one piece's targets into quiet moves and captures, so the flags come for free
+void ChessPosition::addMoves(MoveList& moves, int fromSquare, uint64_t targets, uint64_t occupied) {
+    BitboardElement(targets & ~occupied).forEachBit([&](int toSquare) {
+        moves.add(fromSquare, toSquare, QuietMove);
+    });
+    BitboardElement(targets & occupied).forEachBit([&](int toSquare) {
+        moves.add(fromSquare, toSquare, Capture);
+    });
+}
+
+// knight
+void ChessPosition::generateKnightmoves(MoveList& moves, BitboardElement knightBoard, uint64_t emptySquares, uint64_t occupied) {
+    knightBoard.forEachBit([&](int fromSquare) {
+        addMoves(moves, fromSquare, KnightAttacks[fromSquare] & emptySquares & legalTargets(fromSquare), occupied);
+    });
+}
+
+// king
+// every side dependent square and mask below is a constant once Us is known
+template <Color Us>
+void ChessPosition::generateKingmoves(MoveList& moves, BitboardElement kingBoard, uint64_t targets, uint64_t occupied, uint64_t danger, bool castles) {
+    constexpr int homeSquare = (Us == White) ? 4 : 60;
+    constexpr int KingSideRight = (Us == White) ? WhiteKingSide : BlackKingSide;
+    constexpr int QueenSideRight = (Us == White) ? WhiteQueenSide : BlackQueenSide;
+    constexpr uint64_t KingSideMask = (Us == White) ? ((1ULL << 6) | (1ULL << 5)) : ((1ULL << 61) | (1ULL << 62));
+    constexpr uint64_t QueenSideMask = (Us == White) ? ((1ULL << 1) | (1ULL << 2) | (1ULL << 3)) : ((1ULL << 57) | (1ULL << 58) | (1ULL << 59));
+    constexpr uint64_t QueenSidePath = (Us == White) ? ((1ULL << 2) | (1ULL << 3)) : ((1ULL << 58) | (1ULL << 59));
+    constexpr uint64_t QueenRook = (Us == White) ? (1ULL << 0) : (1ULL << 56);
+    constexpr uint64_t KingRook = (Us == White) ? (1ULL << 7) : (1ULL << 63);
+
+    kingBoard.forEachBit([&](int fromSquare) {
+        // castling: the king may not start in, pass through or land on an attacked square
+        if (castles && (_castlingRights & (KingSideRight | QueenSideRight)) && fromSquare == homeSquare && !(danger & (1ULL << fromSquare))) {
+            uint64_t rooks = ChessBoard[BoardIndex(Rook, Us)].getData();
+            bool KingSideCastle = !(occupied & KingSideMask) && !(danger & KingSideMask) && (rooks & KingRook);
+            bool QueenSideCastle = !(occupied & QueenSideMask) && !(danger & QueenSidePath) && (rooks & QueenRook);
+            if (QueenSideCastle && (_castlingRights & QueenSideRight)) {
+                moves.add(fromSquare, homeSquare - 2, QueenCastle);
+            }
+            if (KingSideCastle && (_castlingRights & KingSideRight)) {
+                moves.add(fromSquare, homeSquare + 2, KingCastle);
+            }
+        }
+        addMoves(moves, fromSquare, KingAttacks[fromSquare] & targets, occupied);
+    });
+}
+
+// pawn moves
+// whole-board shifts: every pawn pushes and captures at once, only the serialising loops per move
+template <Color Us>
+void ChessPosition::generatePawnmoves(MoveList& moves, uint64_t pawns, uint64_t emptySquares, uint64_t enemySquares, uint64_t targetMask, GenType type) {
+    constexpr int up = (Us == White) ? 8 : -8;
+    constexpr uint64_t promotionRank = (Us == White) ? RANK_8 : RANK_1;
+    constexpr uint64_t doublePushRank = (Us == White) ? RANK_4 : RANK_5;
+    constexpr Direction Up = (Us == White) ? North : South;
+    constexpr Direction UpWest = (Us == White) ? NorthWest : SouthWest;
+    constexpr Direction UpEast = (Us == White) ? NorthEast : SouthEast;
+
+    // a blocked single push also blocks the double push
+    BitboardElement pawnBoard(pawns);
+    uint64_t singlePushes = pawnBoard.shift<Up>().getData() & emptySquares;
+    uint64_t doublePushes = BitboardElement(singlePushes).shift<Up>().getData() & emptySquares & doublePushRank & targetMask;
+    singlePushes &= targetMask;
+
+    uint64_t westCaptures = pawnBoard.shift<UpWest>().getData() & enemySquares & targetMask;
+    uint64_t eastCaptures = pawnBoard.shift<UpEast>().getData() & enemySquares & targetMask;
+
+    // promotions count as captures, they change the material just as much
+    if (type != GenQuiets) {
+        addPawnMoves(moves, westCaptures & ~promotionRank, up - 1, Capture);
+        addPawnMoves(moves, eastCaptures & ~promotionRank, up + 1, Capture);
+        addPawnPromotions(moves, singlePushes & promotionRank, up, KnightPromotion);
+        addPawnPromotions(moves, westCaptures & promotionRank, up - 1, KnightPromotionCapture);
+        addPawnPromotions(moves, eastCaptures & promotionRank, up + 1, KnightPromotionCapture);
+    }
+    if (type != GenCaptures) {
+        addPawnMoves(moves, singlePushes & ~promotionRank, up, QuietMove);
+        addPawnMoves(moves, doublePushes, 2 * up, DoublePawnPush);
+    }
+}
+
+// pawns that can take en passant are the ones an enemy pawn on the en passant square would attack
+template <Color Us>
+void ChessPosition::generateEnPassant(MoveList& moves, uint64_t pawns) {
+    if (enPassantSquare == -1) return;
+
+    uint64_t attackers = PawnAttacks[~Us][enPassantSquare] & pawns;
+    BitboardElement(attackers).forEachBit([&](int fromSquare) {
+        if (enPassantIsLegal<Us>(fromSquare, enPassantSquare)) {
+            moves.add(fromSquare, enPassantSquare, EnPassantCapture);
+        }
+    });
+}
+
+// offset is how far every pawn in the set moved, so from is just to - offset
+void ChessPosition::addPawnMoves(MoveList& moves, uint64_t targets, int offset, int flags) {
+    BitboardElement(targets).forEachBit([&](int toSquare) {
+        moves.add(toSquare - offset, toSquare, flags);
+    });
+}
+
+void ChessPosition::addPawnPromotions(MoveList& moves, uint64_t targets, int offset, int flags) {
+    BitboardElement(targets).forEachBit([&](int toSquare) {
+        // queen first, it's almost always the one that gets played
+        for (int promotion = 3; promotion >= 0; promotion--) {
+            moves.add(toSquare - offset, toSquare, flags | promotion);
+        }
+    });
+}
+
+// sliders
+// fancy magic bitboards: every square gets its own slice of a shared attack table,
+// indexed by ((occupancy & mask) * magic) >> shift
+// on x86-64 with fast BMI2 the same slices are indexed by pext(occupancy, mask) instead,
+// both use popcount(mask) bits per square so the tables are the same size either way
+struct SliderMagic {
+    uint64_t mask;
+    uint64_t magic;
+    uint64_t* attacks;
+    int shift;
+};
+
+static const uint64_t BishopMagicNumbers[64] = {
+    0x2008021012002502ULL, 0x04D0100110628400ULL, 0x21102080A1021010ULL, 0x2044041080000400ULL,
+    0x0004050402800000ULL, 0x0002010420109560ULL, 0x08040084500A0000ULL, 0x9401002104224008ULL,
+    0x40044350070B0100ULL, 0x90B00888088C1040ULL, 0x0100100440444012ULL, 0x80001104008A0940ULL,
+    0x1042920210504048ULL, 0x0000010420048200ULL, 0x000000A410221000ULL, 0x804800829C901001ULL,
+    0x0040002008010120ULL, 0x8802008424280205ULL, 0x200800010A040010ULL, 0x2420800802004008ULL,
+    0x0012011402A21220ULL, 0x2002028508022208ULL, 0x0486200049100802ULL, 0x2000211101080200ULL,
+    0x8020200044140C60ULL, 0x0810680C05080381ULL, 0x0001442028012400ULL, 0x4028088008020002ULL,
+    0x25C1001041004010ULL, 0x0401020049080140ULL, 0x0004004084210400ULL, 0x40010900104400A0ULL,
+    0x011011480004A800ULL, 0x0082020200A0680BULL, 0x0800203000080082ULL, 0x0005020081880080ULL,
+    0x1050120080001004ULL, 0x0020008880030810ULL, 0x2241180900008C30ULL, 0x0201451101012400ULL,
+    0x8444016008025000ULL, 0x0002080104000800ULL, 0x2801001490090200ULL, 0x0500142018001100ULL,
+    0x0300040408200400ULL, 0x0008008800820810ULL, 0x0804210204004212ULL, 0x000800A698800202ULL,
+    0x0411040202401000ULL, 0x0A008C051802000EULL, 0x1002A100A8040022ULL, 0x00000C0084042600ULL,
+    0x1000884048220000ULL, 0x0082200410208000ULL, 0x0222020441140022ULL, 0x1004080800408810ULL,
+    0x0022410801500201ULL, 0x010000410818020BULL, 0x2044000044040410ULL, 0x00200C0100208801ULL,
+    0x080800200A102400ULL, 0x000404C010020090ULL, 0x1002101418808C03ULL, 0x0011300081040020ULL
+};
+
+static const uint64_t RookMagicNumbers[64] = {
+    0xA680042040001480ULL, 0x40C0014010002000ULL, 0x0200100820804202ULL, 0x0900100008210004ULL,
+    0x4A00108402000820ULL, 0x2200040200018810ULL, 0x03000100220008ACULL, 0x4080002044800D00ULL,
+    0x008C800080400820ULL, 0x400240012002D000ULL, 0x0001001041002008ULL, 0x0110801000080080ULL,
+    0x0001000500100800ULL, 0x8A46000408020010ULL, 0x00040010084104A2ULL, 0x014A000220804401ULL,
+    0x80102A8000400088ULL, 0x0020008020804000ULL, 0x4010008010200081ULL, 0x0208010100100020ULL,
+    0x2091010008001005ULL, 0x0002008080020400ULL, 0x240024001110C208ULL, 0x0400120001008054ULL,
+    0x8080208080004004ULL, 0x80DD5004C0042000ULL, 0x0410040120080120ULL, 0x2000D00180380080ULL,
+    0x0008000880040080ULL, 0x100A000200080410ULL, 0x0300080400100102ULL, 0x6200008200011044ULL,
+    0x061481400C800060ULL, 0x1001004001002084ULL, 0x0000200080801000ULL, 0x840010010100200BULL,
+    0x0028040080800800ULL, 0x0882000406001830ULL, 0x0001005421001200ULL, 0x000001804600010CULL,
+    0x0000804000208000ULL, 0x4400402010044000ULL, 0x4010008020028014ULL, 0x0000090410010020ULL,
+    0x0000080100110005ULL, 0x0A00201004080140ULL, 0x0000040200010100ULL, 0x0220007081020004ULL,
+    0x840205C981002A00ULL, 0x0000804000200480ULL, 0x0002081040802200ULL, 0x0240230010000900ULL,
+    0x0044800800240180ULL, 0x4011000400080300ULL, 0x00101011088A0C00ULL, 0x1003000080420100ULL,
+    0x0180102100408001ULL, 0x1100108040010021ULL, 0x0182004008108022ULL, 0x0122900128202501ULL,
+    0x0002012004100802ULL, 0x00C200834C081002ULL, 0x0440020110083084ULL, 0x4000484884010022ULL
+};
+
+static SliderMagic BishopMagics[64];
+static SliderMagic RookMagics[64];
+// picked once before the tables are filled, the tables are laid out for whichever one it is
+static bool UsePext = false;
+static uint64_t BishopAttackTable[5248];
+static uint64_t RookAttackTable[102400];
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHESS_X86_64 1
+#endif
+
+static inline uint64_t pext(uint64_t source, uint64_t mask) {
+#if defined(CHESS_X86_64) && defined(_MSC_VER)
+    return _pext_u64(source, mask);
+#elif defined(CHESS_X86_64)
+    // inline asm rather than the intrinsic, so nothing has to be built with -mbmi2
+    uint64_t result;
+    asm("pextq %2, %1, %0" : "=r"(result) : "r"(source), "r"(mask));
+    return result;
+#else
+    // never used for lookups off x86, but keeps the build whole
+    uint64_t result = 0ULL;
+    for (uint64_t bit = 1ULL; mask; mask &= mask - 1, bit <<= 1) {
+        if (source & mask & -mask) {
+            result |= bit;
+        }
+    }
+    return result;
+#endif
+}
+
+[[maybe_unused]] static void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(CHESS_X86_64) && defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, (int) leaf, (int) subleaf);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = (unsigned) info[i];
+    }
+#elif defined(CHESS_X86_64)
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#endif
+}
+
+// bmi2 alone isn't enough, amd before zen 3 runs pext in microcode and it is slower than a multiply
+static bool cpuHasFastPext() {
+#if defined(CHESS_SLIDERS_MAGIC)
+    return false;
+#elif defined(CHESS_SLIDERS_PEXT)
+    return true;
+#elif defined(CHESS_X86_64)
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+    bool amd = regs[1] == 0x68747541; // "Auth"enticAMD
+    if (maxLeaf < 7) {
+        return false;
+    }
+
+    cpuid(7, 0, regs);
+    bool bmi2 = regs[1] & (1u << 8);
+    if (!bmi2 || !amd) {
+        return bmi2;
+    }
+
+    cpuid(1, 0, regs);
+    unsigned family = (regs[0] >> 8) & 0xF;
+    if (family == 0xF) {
+        family += (regs[0] >> 20) & 0xFF;
+    }
+    return family >= 0x19;
+#else
+    return false;
+#endif
+}
+
+void ChessPosition::pickSliderBackend() {
+    UsePext = cpuHasFastPext();
+}
+
+const char* ChessPosition::sliderBackend() {
+    ensureTables();
+    return UsePext ? "pext" : "magic";
+}
+
+// the attack sets straight from the occluded fills, only used to fill the tables
+static uint64_t bishopRays(int sq, uint64_t occupied) {
+    BitboardElement bishop(1ULL << sq);
+    return (bishop.slide<NorthEast>(~occupied) | bishop.slide<NorthWest>(~occupied)
+          | bishop.slide<SouthEast>(~occupied) | bishop.slide<SouthWest>(~occupied)).getData();
+}
+
+static uint64_t rookRays(int sq, uint64_t occupied) {
+    BitboardElement rook(1ULL << sq);
+    return (rook.slide<North>(~occupied) | rook.slide<South>(~occupied)
+          | rook.slide<East>(~occupied) | rook.slide<West>(~occupied)).getData();
+}
+
+static inline uint64_t sliderIndex(const SliderMagic& m, uint64_t occupied) {
+    if (UsePext) {
+        return pext(occupied, m.mask);
+    }
+    return ((occupied & m.mask) * m.magic) >> m.shift;
+}
+
+static void initSliderMagics(SliderMagic* magics, const uint64_t* magicNumbers, uint64_t* table, uint64_t (*rays)(int, uint64_t)) {
+    uint64_t* next = table;
+    for (int sq = 0; sq < 64; sq++) {
+        // board edges never block, so they stay out of the relevant occupancy
+        uint64_t edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (sq / 8 * 8))) | ((FILE_A | FILE_H) & ~(FILE_A << (sq % 8)));
+        SliderMagic& m = magics[sq];
+        m.mask = rays(sq, 0ULL) & ~edges;
+        m.magic = magicNumbers[sq];
+        m.shift = 64 - BitboardElement(m.mask).count();
+        m.attacks = next;
+
+        // walk every subset of the mask (carry-rippler) and store its attack set
+        uint64_t subset = 0ULL;
+        do {
+            m.attacks[sliderIndex(m, subset)] = rays(sq, subset);
+            subset = (subset - m.mask) & m.mask;
+        } while (subset);
+
+        next += 1ULL << (64 - m.shift);
+    }
+}
+
+void ChessPosition::getBishopmoves() {
+    initSliderMagics(BishopMagics, BishopMagicNumbers, BishopAttackTable, bishopRays);
+}
+
+void ChessPosition::getRookmoves() {
+    initSliderMagics(RookMagics, RookMagicNumbers, RookAttackTable, rookRays);
+}
+
+uint64_t ChessPosition::bishopAttacks(int sq, uint64_t occupied) {
+    const SliderMagic& m = BishopMagics[sq];
+    return m.attacks[sliderIndex(m, occupied)];
+}
+
+uint64_t ChessPosition::rookAttacks(int sq, uint64_t occupied) {
+    const SliderMagic& m = RookMagics[sq];
+    return m.attacks[sliderIndex(m, occupied)];
+}
+
+void ChessPosition::generateBishopmoves(MoveList& moves, BitboardElement bishopBoard, uint64_t notFriendly, uint64_t occupied) {
+    bishopBoard.forEachBit([&](int fromSquare) {
+        addMoves(moves, fromSquare, (_incremental ? _pieceAttacks[fromSquare] : bishopAttacks(fromSquare, occupied)) & notFriendly & legalTargets(fromSquare), occupied);
+    });
+}
+
+void ChessPosition::generateRookmoves(MoveList& moves, BitboardElement rookBoard, uint64_t notFriendly, uint64_t occupied) {
+    rookBoard.forEachBit([&](int fromSquare) {
+        addMoves(moves, fromSquare, (_incremental ? _pieceAttacks[fromSquare] : rookAttacks(fromSquare, occupied)) & notFriendly & legalTargets(fromSquare), occupied);
+    });
+}
+
+void ChessPosition::generateQueenmoves(MoveList& moves, BitboardElement queenBoard, uint64_t notFriendly, uint64_t occupied) {
+    queenBoard.forEachBit([&](int fromSquare) {
+        uint64_t attacks = _incremental ? _pieceAttacks[fromSquare] : bishopAttacks(fromSquare, occupied) | rookAttacks(fromSquare, occupied);
+        addMoves(moves, fromSquare, attacks & notFriendly & legalTargets(fromSquare), occupied);
+    });
+}
+
+// incremental attacks
+uint64_t ChessPosition::attacksFrom(int square, uint64_t occupied) const {
+    switch (pieceTypeOn(square)) {
+        case Pawn:   return PawnAttacks[ownerOn(square)][square];
+        case Knight: return KnightAttacks[square];
+        case Bishop: return bishopAttacks(square, occupied);
+        case Rook:   return rookAttacks(square, occupied);
+        case Queen:  return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+        case King:   return KingAttacks[square];
+        default:     return 0ULL;
+    }
+}
+
+// changed holds every square a move emptied or filled; leapers only need a new set when they stand on one,
+// a slider also when its rays reached one of them, since that square is where a ray now stops or runs on
+void ChessPosition::refreshAttacks(uint64_t changed) {
+    uint64_t occupied = getOccupancy();
+    for (int sq : BitboardElement(changed)) {
+        _pieceAttacks[sq] = attacksFrom(sq, occupied);
+    }
+    uint64_t sliders = 0ULL;
+    for (int player = 0; player < 2; player++) {
+        sliders |= ChessBoard[BoardIndex(Bishop, player)].getData() | ChessBoard[BoardIndex(Rook, player)].getData()
+                 | ChessBoard[BoardIndex(Queen, player)].getData();
+    }
+    for (int sq : BitboardElement(sliders & ~changed)) {
+        if (_pieceAttacks[sq] & changed) {
+            _pieceAttacks[sq] = attacksFrom(sq, occupied);
+        }
+    }
+}
+
+void ChessPosition::setIncrementalAttacks(bool on) {
+    _incremental = on;
+    if (on) {
+        refreshAttacks(~0ULL);
+    }
+}
+
+// legality
+// squares strictly between two aligned squares, and the full line through them
+static uint64_t SquaresBetween[64][64];
+static uint64_t SquaresLine[64][64];
+
+void ChessPosition::getLinemasks() {
+    for (int s1 = 0; s1 < 64; s1++) {
+        for (int s2 = 0; s2 < 64; s2++) {
+            uint64_t b1 = 1ULL << s1;
+            uint64_t b2 = 1ULL << s2;
+            SquaresBetween[s1][s2] = 0ULL;
+            SquaresLine[s1][s2] = 0ULL;
+            if (s1 == s2) continue;
+
+            if (rookAttacks(s1, 0ULL) & b2) {
+                SquaresLine[s1][s2] = (rookAttacks(s1, 0ULL) & rookAttacks(s2, 0ULL)) | b1 | b2;
+                SquaresBetween[s1][s2] = rookAttacks(s1, b2) & rookAttacks(s2, b1);
+            } else if (bishopAttacks(s1, 0ULL) & b2) {
+                SquaresLine[s1][s2] = (bishopAttacks(s1, 0ULL) & bishopAttacks(s2, 0ULL)) | b1 | b2;
+                SquaresBetween[s1][s2] = bishopAttacks(s1, b2) & bishopAttacks(s2, b1);
+            }
+        }
+    }
+}
+
+// every piece of either color that attacks square
+uint64_t ChessPosition::attackersTo(int square, uint64_t occupied) const {
+    uint64_t rooks = ChessBoard[BoardIndex(Rook, 0)].getData() | ChessBoard[BoardIndex(Queen, 0)].getData()
+                   | ChessBoard[BoardIndex(Rook, 1)].getData() | ChessBoard[BoardIndex(Queen, 1)].getData();
+    uint64_t bishops = ChessBoard[BoardIndex(Bishop, 0)].getData() | ChessBoard[BoardIndex(Queen, 0)].getData()
+                     | ChessBoard[BoardIndex(Bishop, 1)].getData() | ChessBoard[BoardIndex(Queen, 1)].getData();
+
+    // a white pawn attacks square from where a black pawn on square would attack, and the other way round
+    return (PawnAttacks[1][square] & ChessBoard[BoardIndex(Pawn, 0)].getData())
+         | (PawnAttacks[0][square] & ChessBoard[BoardIndex(Pawn, 1)].getData())
+         | (KnightAttacks[square] & (ChessBoard[BoardIndex(Knight, 0)].getData() | ChessBoard[BoardIndex(Knight, 1)].getData()))
+         | (KingAttacks[square] & (ChessBoard[BoardIndex(King, 0)].getData() | ChessBoard[BoardIndex(King, 1)].getData()))
+         | (rookAttacks(square, occupied) & rooks)
+         | (bishopAttacks(square, occupied) & bishops);
+}
+
+// every square Us attacks, the opposing king is expected to be left out of occupied
+template <Color Us>
+uint64_t ChessPosition::attackedSquares(uint64_t occupied) const {
+    constexpr int player = Us;
+    if (_incremental) {
+        // the cache was filled with every piece on the board, only a slider that ran into a square
+        // taken off occupied (the king it checks, when building the danger map) sees further now
+        uint64_t removed = getOccupancy() & ~occupied;
+        uint64_t attacks = 0ULL;
+        for (int sq : BitboardElement(getPieces(player))) {
+            bool slider = pieceTypeOn(sq) >= Bishop && pieceTypeOn(sq) <= Queen;
+            attacks |= (slider && (_pieceAttacks[sq] & removed)) ? attacksFrom(sq, occupied) : _pieceAttacks[sq];
+        }
+        return attacks;
+    }
+    constexpr Direction UpWest = (Us == White) ? NorthWest : SouthWest;
+    constexpr Direction UpEast = (Us == White) ? NorthEast : SouthEast;
+    const BitboardElement& pawns = ChessBoard[BoardIndex(Pawn, player)];
+    uint64_t attacks = (pawns.shift<UpWest>() | pawns.shift<UpEast>()).getData();
+
+    ChessBoard[BoardIndex(Knight, player)].forEachBit([&](int sq) {
+        attacks |= KnightAttacks[sq];
+    });
+    ChessBoard[BoardIndex(King, player)].forEachBit([&](int sq) {
+        attacks |= KingAttacks[sq];
+    });
+    uint64_t queens = ChessBoard[BoardIndex(Queen, player)].getData();
+    BitboardElement(ChessBoard[BoardIndex(Bishop, player)].getData() | queens).forEachBit([&](int sq) {
+        attacks |= bishopAttacks(sq, occupied);
+    });
+    BitboardElement(ChessBoard[BoardIndex(Rook, player)].getData() | queens).forEachBit([&](int sq) {
+        attacks |= rookAttacks(sq, occupied);
+    });
+    return attacks;
+}
+
+bool ChessPosition::isSquareAttacked(int square, int byPlayer) const {
+    return attackersTo(square, getOccupancy()) & getPieces(byPlayer);
+}
+
+bool ChessPosition::inCheck() const {
+    uint64_t king = ChessBoard[BoardIndex(King, _sideToMove)].getData();
+    return king && isSquareAttacked(BitboardElement(king).lsb(), _sideToMove ^ 1);
+}
+
+uint64_t ChessPosition::getPieces(int player) const {
+    uint64_t pieces = 0ULL;
+    for (int piece = Pawn; piece <= King; piece++) {
+        pieces |= ChessBoard[BoardIndex((ChessPiece) piece, player)].getData();
+    }
+    return pieces;
+}
+
+uint64_t ChessPosition::getOccupancy() const {
+    return getPieces(0) | getPieces(1);
+}
+
+// static exchange evaluation
+ChessPiece ChessPosition::leastValuableAttacker(uint64_t attackers, int player, uint64_t& attackerBit) const {
+    for (int piece = Pawn; piece <= King; piece++) {
+        uint64_t bb = attackers & ChessBoard[BoardIndex((ChessPiece) piece, player)].getData();
+        if (bb) {
+            attackerBit = bb & (0ULL - bb);
+            return (ChessPiece) piece;
+        }
+    }
+    attackerBit = 0ULL;
+    return NoPiece;
+}
+
+// sliders that were hiding behind a piece that just left, only the ones on its line can appear
+uint64_t ChessPosition::xrayAttackers(int square, ChessPiece removed, uint64_t occupied) const {
+    uint64_t queens = ChessBoard[BoardIndex(Queen, 0)].getData() | ChessBoard[BoardIndex(Queen, 1)].getData();
+    uint64_t found = 0ULL;
+    if (removed == Pawn || removed == Bishop || removed == Queen) {
+        found |= bishopAttacks(square, occupied)
+               & (ChessBoard[BoardIndex(Bishop, 0)].getData() | ChessBoard[BoardIndex(Bishop, 1)].getData() | queens);
+    }
+    if (removed == Rook || removed == Queen) {
+        found |= rookAttacks(square, occupied)
+               & (ChessBoard[BoardIndex(Rook, 0)].getData() | ChessBoard[BoardIndex(Rook, 1)].getData() | queens);
+    }
+    return found;
+}
+
+int ChessPosition::see(BitMove move) const {
+    // castles and promotions don't trade anything away on the square
+    if (move.isCastle() || move.isPromotion()) {
+        return 0;
+    }
+
+    int from = move.from();
+    int to = move.to();
+    int player = _sideToMove;
+    uint64_t occupied = getOccupancy() ^ (1ULL << from);
+    if (move.flags() == EnPassantCapture) {
+        occupied ^= 1ULL << (player == 0 ? to - 8 : to + 8);
+    }
+
+    // gain[d] is what the side capturing at depth d has won so far, if the other side stops there
+    int gain[32];
+    int d = 0;
+    gain[0] = (move.flags() == EnPassantCapture) ? PieceValues[Pawn] : PieceValues[pieceTypeOn(to)];
+    ChessPiece onSquare = pieceTypeOn(from);
+    uint64_t attackers = attackersTo(to, occupied) & occupied;
+
+    int side = player;
+    while (d < 31) {
+        side ^= 1;
+        uint64_t attackerBit;
+        ChessPiece attacker = leastValuableAttacker(attackers, side, attackerBit);
+        if (attacker == NoPiece) {
+            break;
+        }
+        // a king can only take last, when nothing defends the square any more
+        if (attacker == King && (attackers & getPieces(side ^ 1) & ~attackerBit)) {
+            break;
+        }
+        d++;
+        gain[d] = PieceValues[onSquare] - gain[d - 1];
+        onSquare = attacker;
+        occupied ^= attackerBit;
+        attackers = (attackers | xrayAttackers(to, attacker, occupied)) & occupied;
+    }
+
+    // either side may stop recapturing when it's not worth it
+    while (d > 0) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+bool ChessPosition::seeGreaterEqual(BitMove move, int threshold) const {
+    if (move.isCastle() || move.isPromotion()) {
+        return 0 >= threshold;
+    }
+
+    int from = move.from();
+    int to = move.to();
+    int player = _sideToMove;
+
+    // balance is the score with the other side to move, so each capture flips who it needs to favour
+    int balance = ((move.flags() == EnPassantCapture) ? PieceValues[Pawn] : PieceValues[pieceTypeOn(to)]) - threshold;
+    if (balance < 0) {
+        return false;
+    }
+    ChessPiece onSquare = pieceTypeOn(from);
+    balance -= PieceValues[onSquare];
+    if (balance >= 0) {
+        return true;
+    }
+
+    uint64_t occupied = getOccupancy() ^ (1ULL << from);
+    if (move.flags() == EnPassantCapture) {
+        occupied ^= 1ULL << (player == 0 ? to - 8 : to + 8);
+    }
+    uint64_t attackers = attackersTo(to, occupied) & occupied;
+
+    int side = player ^ 1;
+    while (true) {
+        uint64_t attackerBit;
+        ChessPiece attacker = leastValuableAttacker(attackers, side, attackerBit);
+        if (attacker == NoPiece) {
+            break;
+        }
+        occupied ^= attackerBit;
+        attackers = (attackers | xrayAttackers(to, attacker, occupied)) & occupied;
+
+        // side takes, and from here on the other side needs to get back above the line
+        side ^= 1;
+        balance = -balance - 1 - PieceValues[attacker];
+        if (balance >= 0) {
+            // a king can't take into a square that is still defended
+            if (attacker == King && (attackers & getPieces(side))) {
+                side ^= 1;
+            }
+            break;
+        }
+    }
+    // whoever is left to move at the end lost the exchange
+    return side != player;
+}
+
+// own pieces that are the only thing standing between our king and an enemy slider
+template <Color Us>
+uint64_t ChessPosition::pinnedPieces(int kingSquare, uint64_t own, uint64_t occupied) {
+    constexpr int enemy = ~Us;
+    uint64_t queens = ChessBoard[BoardIndex(Queen, enemy)].getData();
+    uint64_t snipers = (rookAttacks(kingSquare, 0ULL) & (ChessBoard[BoardIndex(Rook, enemy)].getData() | queens))
+                     | (bishopAttacks(kingSquare, 0ULL) & (ChessBoard[BoardIndex(Bishop, enemy)].getData() | queens));
+    uint64_t pinned = 0ULL;
+
+    BitboardElement(snipers).forEachBit([&](int sniper) {
+        uint64_t blockers = SquaresBetween[kingSquare][sniper] & occupied;
+        if (blockers && !(blockers & (blockers - 1))) {
+            pinned |= blockers & own;
+        }
+    });
+    return pinned;
+}
+
+// where the piece on fromSquare may go without leaving the king in check
+uint64_t ChessPosition::legalTargets(int fromSquare) const {
+    if (_pinned & (1ULL << fromSquare)) {
+        return _checkMask & SquaresLine[_kingSquare][fromSquare];
+    }
+    return _checkMask;
+}
+
+// en passant removes two pieces from one rank, so just try it on the occupancy
+template <Color Us>
+bool ChessPosition::enPassantIsLegal(int fromSquare, int toSquare) {
+    if (_kingSquare == -1) return true;
+
+    int captured = (Us == White) ? toSquare - 8 : toSquare + 8;
+    uint64_t occupied = getOccupancy() ^ ((1ULL << fromSquare) | (1ULL << toSquare) | (1ULL << captured));
+    uint64_t enemies = getPieces(~Us) & ~(1ULL << captured);
+    return !(attackersTo(_kingSquare, occupied) & enemies);
+}
+
+void ChessPosition::makeMove(BitMove m) {
+    if (_sideToMove == White) {
+        makeMove<White>(m);
+    } else {
+        makeMove<Black>(m);
+    }
+}
+
+template <Color Us>
+void ChessPosition::makeMove(BitMove m) {
+    constexpr int player = Us;
+    constexpr int enemy = ~Us;
+    int from = m.from();
+    int to = m.to();
+    int flags = m.flags();
+    ChessPiece piece = pieceTypeOn(from);
+
+    // remember what this move destroys so unmakeMove can put it back
+    UndoInfo& undo = _undoStack[_undoCount++ & (MaxUndo - 1)];
+    undo.captured = NoPiece;
+    undo.castlingRights = (uint8_t) _castlingRights;
+    undo.enPassantSquare = (int8_t) enPassantSquare;
+    undo.halfmoveClock = (uint16_t) _halfmoveClock;
+    undo.hash = _hash;
+    undo.materialKey = _materialKey;
+    _legalityValid = false;
+    // every square this move empties or fills, for the attack cache
+    uint64_t changed = (1ULL << from) | (1ULL << to);
+
+    // update captures 
+    if (flags == EnPassantCapture) {
+        int pass = (Us == White) ? to - 8 : to + 8;
+        changed |= 1ULL << pass;
+        ChessBoard[BoardIndex(Pawn, enemy)] ^= 1ULL << pass;
+        _hash ^= ZobristPieces[BoardIndex(Pawn, enemy)][pass];
+        _materialKey ^= ZobristMaterial[BoardIndex(Pawn, enemy)][ChessBoard[BoardIndex(Pawn, enemy)].count()];
+        _pieceOn[pass] = 0;
+        undo.captured = Pawn;
+    } else if (m.isCapture()) {
+        undo.captured = (uint8_t) pieceTypeOn(to);
+        int capturedBoard = BoardIndex((ChessPiece) undo.captured, enemy);
+        ChessBoard[capturedBoard] ^= 1ULL << to;
+        _hash ^= ZobristPieces[capturedBoard][to];
+        _materialKey ^= ZobristMaterial[capturedBoard][ChessBoard[capturedBoard].count()];
+    }
+
+    // place the move internely, a promoting pawn leaves the board and the new piece arrives
+    if (m.isPromotion()) {
+        ChessPiece promoted = m.promotion();
+        ChessBoard[BoardIndex(Pawn, player)] ^= 1ULL << from;
+        ChessBoard[BoardIndex(promoted, player)] ^= 1ULL << to;
+        _hash ^= ZobristPieces[BoardIndex(Pawn, player)][from] ^ ZobristPieces[BoardIndex(promoted, player)][to];
+        _materialKey ^= ZobristMaterial[BoardIndex(Pawn, player)][ChessBoard[BoardIndex(Pawn, player)].count()];
+        _materialKey ^= ZobristMaterial[BoardIndex(promoted, player)][ChessBoard[BoardIndex(promoted, player)].count() - 1];
+        _pieceOn[to] = PieceCode(promoted, player);
+    } else {
+        ChessBoard[BoardIndex(piece, player)] ^= (1ULL << from) | (1ULL << to);
+        _hash ^= ZobristPieces[BoardIndex(piece, player)][from] ^ ZobristPieces[BoardIndex(piece, player)][to];
+        _pieceOn[to] = _pieceOn[from];
+    }
+    _pieceOn[from] = 0;
+
+    // castling moves the rook along with the king
+    if (m.isCastle()) {
+        int rfrom = (flags == KingCastle) ? from + 3 : from - 4;
+        int rto = (flags == KingCastle) ? from + 1 : from - 1;
+        changed |= (1ULL << rfrom) | (1ULL << rto);
+        ChessBoard[BoardIndex(Rook, player)] ^= (1ULL << rfrom) | (1ULL << rto);
+        _hash ^= ZobristPieces[BoardIndex(Rook, player)][rfrom] ^ ZobristPieces[BoardIndex(Rook, player)][rto];
+        _pieceOn[rto] = _pieceOn[rfrom];
+        _pieceOn[rfrom] = 0;
+    }
+    // a king or rook leaving home, or a rook captured on its corner, loses that castle for good
+    _hash ^= ZobristCastling[_castlingRights];
+    _castlingRights &= CastlingRightsMask[from] & CastlingRightsMask[to];
+    _hash ^= ZobristCastling[_castlingRights];
+
+    // a double push leaves an en passant square behind it
+    if (enPassantSquare != -1) {
+        _hash ^= ZobristEnPassant[enPassantSquare % 8];
+    }
+    enPassantSquare = (flags == DoublePawnPush) ? (from + to) / 2 : -1;
+    if (enPassantSquare != -1) {
+        _hash ^= ZobristEnPassant[enPassantSquare % 8];
+    }
+
+    // move clocks
+    _halfmoveClock = (piece == Pawn || undo.captured != NoPiece) ? 0 : _halfmoveClock + 1;
+    if (Us == Black) {
+        _fullmoveNumber++;
+    }
+    _sideToMove = enemy;
+    _hash ^= ZobristSide;
+    if (_incremental) {
+        refreshAttacks(changed);
+    }
+}
+
+void ChessPosition::unmakeMove(BitMove m) {
+    // the side that made the move is the one not to move now
+    if (_sideToMove == Black) {
+        unmakeMove<White>(m);
+    } else {
+        unmakeMove<Black>(m);
+    }
+}
+
+template <Color Us>
+void ChessPosition::unmakeMove(BitMove m) {
+    constexpr int player = Us;
+    constexpr int enemy = ~Us;
+    const UndoInfo& undo = _undoStack[--_undoCount & (MaxUndo - 1)];
+    int from = m.from();
+    int to = m.to();
+    int flags = m.flags();
+    ChessPiece piece = pieceTypeOn(to);
+
+    _sideToMove = player;
+    if (Us == Black) {
+        _fullmoveNumber--;
+    }
+    _castlingRights = undo.castlingRights;
+    enPassantSquare = undo.enPassantSquare;
+    _halfmoveClock = undo.halfmoveClock;
+    _hash = undo.hash;
+    _materialKey = undo.materialKey;
+    _legalityValid = false;
+    uint64_t changed = (1ULL << from) | (1ULL << to);
+
+    if (m.isPromotion()) {
+        ChessBoard[BoardIndex(piece, player)] ^= 1ULL << to;
+        ChessBoard[BoardIndex(Pawn, player)] ^= 1ULL << from;
+        _pieceOn[from] = PieceCode(Pawn, player);
+    } else {
+        ChessBoard[BoardIndex(piece, player)] ^= (1ULL << from) | (1ULL << to);
+        _pieceOn[from] = _pieceOn[to];
+    }
+    _pieceOn[to] = 0;
+
+    if (m.isCastle()) {
+        int rfrom = (flags == KingCastle) ? from + 3 : from - 4;
+        int rto = (flags == KingCastle) ? from + 1 : from - 1;
+        changed |= (1ULL << rfrom) | (1ULL << rto);
+        ChessBoard[BoardIndex(Rook, player)] ^= (1ULL << rfrom) | (1ULL << rto);
+        _pieceOn[rfrom] = _pieceOn[rto];
+        _pieceOn[rto] = 0;
+    }
+
+    if (flags == EnPassantCapture) {
+        int pass = (Us == White) ? to - 8 : to + 8;
+        changed |= 1ULL << pass;
+        ChessBoard[BoardIndex(Pawn, enemy)] ^= 1ULL << pass;
+        _pieceOn[pass] = PieceCode(Pawn, enemy);
+    } else if (undo.captured != NoPiece) {
+        ChessBoard[BoardIndex((ChessPiece) undo.captured, enemy)] ^= 1ULL << to;
+        _pieceOn[to] = PieceCode((ChessPiece) undo.captured, enemy);
+    }
+    if (_incremental) {
+        refreshAttacks(changed);
+    }
+}
+
+// who is giving check, what is pinned and where the king may not step
+// fills _kingSquare, _checkers, _pinned and _checkMask and returns the danger squares
+// kept until the next make/unmakeMove, so the MovePicker's stages and isLegal checks share one computation
+template <Color Us>
+uint64_t ChessPosition::computeLegality(uint64_t own, uint64_t enemies, uint64_t occupied) {
+    constexpr int player = Us;
+    if (_legalityValid) {
+        return _danger;
+    }
+    _legalityValid = true;
+    uint64_t kingBoard = ChessBoard[BoardIndex(King, player)].getData();
+    uint64_t& danger = _danger;
+    danger = 0ULL;
+    _checkers = 0ULL;
+    _pinned = 0ULL;
+    _checkMask = ~0ULL;
+    _kingSquare = kingBoard ? BitboardElement(kingBoard).lsb() : -1;
+    if (_kingSquare == -1) {
+        return danger;
+    }
+
+    _checkers = attackersTo(_kingSquare, occupied) & enemies;
+    _pinned = pinnedPieces<Us>(_kingSquare, own, occupied);
+    // the king can't hide behind itself from a slider
+    danger = attackedSquares<~Us>(occupied & ~kingBoard);
+
+    // in single check everything else has to capture the checker or block it, in double check nothing can
+    if (_checkers & (_checkers - 1)) {
+        _checkMask = 0ULL;
+    } else if (_checkers) {
+        _checkMask = SquaresBetween[_kingSquare][BitboardElement(_checkers).lsb()] | _checkers;
+    }
+    return danger;
+}
+
+void ChessPosition::generateAllCurrentMoves(MoveList& Moves) {
+    generateMoves(Moves, GenAll);
+}
+
+void ChessPosition::generateMoves(MoveList& Moves, GenType type, uint64_t fromMask) {
+    if (_sideToMove == White) {
+        generateMoves<White>(Moves, type, fromMask);
+    } else {
+        generateMoves<Black>(Moves, type, fromMask);
+    }
+}
+
+template <Color Us>
+void ChessPosition::generateMoves(MoveList& Moves, GenType type, uint64_t fromMask) {
+    // clear moves 
+    Moves.clear();
+
+    constexpr int player = Us;
+    constexpr int enemy = ~Us;
+
+    // genrate boards
+    uint64_t ownSqrs = getPieces(player);
+    uint64_t enemySqrs = getPieces(enemy);
+    uint64_t occupied = ownSqrs | enemySqrs;
+    uint64_t emptySqrs = ~occupied;
+    // captures land on enemies, quiets on empty squares
+    uint64_t friendlySqrs = (type == GenCaptures) ? enemySqrs : (type == GenQuiets) ? emptySqrs : ~ownSqrs;
+
+    uint64_t danger = computeLegality<Us>(ownSqrs, enemySqrs, occupied);
+
+    generateKingmoves<Us>(Moves, ChessBoard[BoardIndex(King, player)].getData() & fromMask, friendlySqrs & ~danger, occupied, danger, type != GenCaptures);
+
+    // in double check only the king can move
+    if (_checkers & (_checkers - 1)) {
+        return;
+    }
+
+    // pinned pawns are rare, so they get their own pass along the pin line
+    uint64_t pawns = ChessBoard[BoardIndex(Pawn, player)].getData() & fromMask;
+    generatePawnmoves<Us>(Moves, pawns & ~_pinned, emptySqrs, enemySqrs, _checkMask, type);
+    BitboardElement(pawns & _pinned).forEachBit([&](int fromSquare) {
+        generatePawnmoves<Us>(Moves, 1ULL << fromSquare, emptySqrs, enemySqrs, legalTargets(fromSquare), type);
+    });
+    if (type != GenQuiets) {
+        generateEnPassant<Us>(Moves, pawns);
+    }
+
+    generateKnightmoves(Moves, ChessBoard[BoardIndex(Knight, player)].getData() & fromMask, friendlySqrs, occupied);
+    generateBishopmoves(Moves, ChessBoard[BoardIndex(Bishop, player)].getData() & fromMask, friendlySqrs, occupied);
+    generateRookmoves(Moves, ChessBoard[BoardIndex(Rook, player)].getData() & fromMask, friendlySqrs, occupied);
+    generateQueenmoves(Moves, ChessBoard[BoardIndex(Queen, player)].getData() & fromMask, friendlySqrs, occupied);
+}
+
+// a move from somewhere else (hash table, killer slot) is only playable if the generator
+// would have produced it here, so generate for its from square alone and look for it
+bool ChessPosition::isLegal(BitMove move) {
+    if (move == NoMove) {
+        return false;
+    }
+    MoveList moves;
+    generateMoves(moves, GenAll, 1ULL << move.from());
+    for (BitMove legal : moves) {
+        if (legal == move) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// same masks as generateAllCurrentMoves, but stops at the first legal move it finds
+bool ChessPosition::hasLegalMove() {
+    return (_sideToMove == White) ? hasLegalMove<White>() : hasLegalMove<Black>();
+}
+
+template <Color Us>
+bool ChessPosition::hasLegalMove() {
+    constexpr int player = Us;
+    constexpr int enemy = ~Us;
+    uint64_t ownSqrs = getPieces(player);
+    uint64_t enemySqrs = getPieces(enemy);
+    uint64_t occupied = ownSqrs | enemySqrs;
+
+    uint64_t danger = computeLegality<Us>(ownSqrs, enemySqrs, occupied);
+
+    // castling never needs checking, if it is legal so is the king's first step
+    if (_kingSquare != -1 && (KingAttacks[_kingSquare] & ~ownSqrs & ~danger)) {
+        return true;
+    }
+    if (!_checkMask) {
+        return false;
+    }
+
+    // a pinned knight can never move
+    for (int sq : ChessBoard[BoardIndex(Knight, player)] & ~_pinned) {
+        if (KnightAttacks[sq] & ~ownSqrs & _checkMask) {
+            return true;
+        }
+    }
+
+    MoveList pawnMoves;
+    uint64_t pawns = ChessBoard[BoardIndex(Pawn, player)].getData();
+    generatePawnmoves<Us>(pawnMoves, pawns & ~_pinned, ~occupied, enemySqrs, _checkMask, GenAll);
+    if (!pawnMoves.empty()) {
+        return true;
+    }
+
+    uint64_t queens = ChessBoard[BoardIndex(Queen, player)].getData();
+    for (int sq : ChessBoard[BoardIndex(Bishop, player)] | queens) {
+        if (bishopAttacks(sq, occupied) & ~ownSqrs & legalTargets(sq)) {
+            return true;
+        }
+    }
+    for (int sq : ChessBoard[BoardIndex(Rook, player)] | queens) {
+        if (rookAttacks(sq, occupied) & ~ownSqrs & legalTargets(sq)) {
+            return true;
+        }
+    }
+
+    // last the rare ones, pinned pawns and en passant
+    BitboardElement(pawns & _pinned).forEachBit([&](int fromSquare) {
+        generatePawnmoves<Us>(pawnMoves, 1ULL << fromSquare, ~occupied, enemySqrs, legalTargets(fromSquare), GenAll);
+    });
+    generateEnPassant<Us>(pawnMoves, pawns);
+    return !pawnMoves.empty();
+}
+
+bool ChessPosition::isCheckmate() {
+    return inCheck() && !hasLegalMove();
+}
+
+bool ChessPosition::isStalemate() {
+    return !inCheck() && !hasLegalMove();
+}
+
+// a hundred plies without a capture or pawn move, unless that last move mated
+bool ChessPosition::isFiftyMoveDraw() {
+    return _halfmoveClock >= 100 && !isCheckmate();
+}
+
+// the undo stack already keeps the hash from before every move, so it doubles as the history
+// only positions since the last capture or pawn move can repeat, and only with the same side to move
+int ChessPosition::repetitionCount() const {
+    int count = 0;
+    int plies = std::min(std::min(_halfmoveClock, _undoCount), MaxUndo);
+    for (int back = 2; back <= plies; back += 2) {
+        if (_undoStack[(_undoCount - back) & (MaxUndo - 1)].hash == _hash) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool ChessPosition::isThreefoldRepetition() const {
+    return repetitionCount() >= 2;
+}
+
+int ChessPosition::BoardIndex(ChessPiece piece, int player) {
+    //if white returns 0-5 
+    if (player == 0) {
+        return (piece) - 1;
+    } else { // if black return 6-11
+        return (piece) + 5;
+    }
+}
+
+void ChessPosition::PrintChessBoards() {
+    for (int i = 0; i < 12; i++) {
+        ChessBoard[i].printBitboard();
+    }
+}
+
+void ChessPosition::ClearChessBoards() {
+    for (int i = 0; i < 12; i++) {
+        ChessBoard[i].setData(0ULL);
+    }
+    std::fill(std::begin(_pieceOn), std::end(_pieceOn), (uint8_t) 0);
+}
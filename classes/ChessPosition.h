@@ -0,0 +1,207 @@
+#pragma once
+
+#include "Bitboard.h"
+#include <string>
+
+enum CastlingRights
+{
+    NoCastling = 0,
+    WhiteKingSide = 1,
+    WhiteQueenSide = 2,
+    BlackKingSide = 4,
+    BlackQueenSide = 8,
+    AllCastling = 15
+};
+
+enum Color
+{
+    White = 0,
+    Black = 1
+};
+
+constexpr Color operator~(Color color) { return (Color)(color ^ 1); }
+
+// centipawns, indexed by ChessPiece
+inline constexpr int PieceValues[7] = { 0, 100, 320, 330, 500, 900, 20000 };
+
+// which moves a generator call produces, promotions and en passant count as captures
+enum GenType
+{
+    GenAll,
+    GenCaptures,
+    GenQuiets
+};
+
+// what makeMove destroys and unmakeMove has to put back
+struct UndoInfo
+{
+    uint8_t captured;
+    uint8_t castlingRights;
+    int8_t enPassantSquare;
+    uint16_t halfmoveClock;
+    uint64_t hash;
+    uint64_t materialKey;
+};
+
+//
+// the chess board as bitboards only, no Grid, Bit or Sprite in sight
+// the Chess game drives one of these, and so can anything headless (perft, search)
+//
+class ChessPosition
+{
+public:
+    ChessPosition();
+
+    // reads the placement and, when present, side to move, castling and en passant fields
+    // false, and an empty board, when the fen runs past h8, has a letter that isn't a piece, a bad en passant square,
+    // more pieces than a game can have, not exactly one king a side, or the side that just moved in check
+    bool loadFEN(const std::string& fen);
+
+    // moves for the side to move, every one of them legal
+    void generateAllCurrentMoves(MoveList&);
+    // a stage of them, only for pieces standing on fromMask
+    void generateMoves(MoveList&, GenType, uint64_t fromMask = ~0ULL);
+    // would move be generated in this position
+    bool isLegal(BitMove move);
+    // plays a move for the side to move
+    void makeMove(BitMove);
+    // takes back the last move played
+    void unmakeMove(BitMove);
+
+    // game end, cheap enough to ask at every search node
+    bool hasLegalMove();
+    bool isCheckmate();
+    bool isStalemate();
+    bool isFiftyMoveDraw();
+    // how often the current position occurred before, since the last irreversible move
+    int repetitionCount() const;
+    bool isThreefoldRepetition() const;
+
+    int sideToMove() const { return _sideToMove; }
+    int getEnPassantSquare() const { return enPassantSquare; }
+    int getCastlingRights() const { return _castlingRights; }
+    int getHalfmoveClock() const { return _halfmoveClock; }
+    int getFullmoveNumber() const { return _fullmoveNumber; }
+    // zobrist key of the position, kept up to date by makeMove and unmakeMove
+    uint64_t getHash() const { return _hash; }
+    uint64_t computeHash() const;
+    // zobrist style key of the material alone, how many of each piece but not where
+    // only captures and promotions change it, the endgame evaluators are looked up by it
+    uint64_t getMaterialKey() const { return _materialKey; }
+    uint64_t computeMaterialKey() const;
+    // the key a position with counts[BoardIndex(piece, player)] of each piece would have
+    static uint64_t materialKey(const int counts[12]);
+    int pieceCount(ChessPiece piece, int player) const { return getBoard(piece, player).count(); }
+    const BitboardElement& getBoard(ChessPiece piece, int player) const { return ChessBoard[BoardIndex(piece, player)]; }
+    static int BoardIndex(ChessPiece, int);
+    // the mailbox, kept in step with the bitboards: one byte per square, piece | player << 3
+    static constexpr uint8_t PieceCode(ChessPiece piece, int player) { return (uint8_t)(piece | (player << 3)); }
+    ChessPiece pieceTypeOn(int square) const { return (ChessPiece)(_pieceOn[square] & 7); }
+    // only meaningful when something stands on square
+    int ownerOn(int square) const { return _pieceOn[square] >> 3; }
+    uint64_t getPieces(int player) const;
+    uint64_t getOccupancy() const;
+
+    // attack maps
+    // every piece of either color attacking square, given the occupancy to look through
+    uint64_t attackersTo(int square, uint64_t occupied) const;
+    bool isSquareAttacked(int square, int byPlayer) const;
+    bool inCheck() const;
+
+    // static exchange evaluation: what the side to move nets on the to square of move
+    // if both sides keep recapturing with their cheapest piece, x-rays included (pins are not)
+    int see(BitMove move) const;
+    // see(move) >= threshold, usually without resolving the whole exchange
+    bool seeGreaterEqual(BitMove move, int threshold) const;
+
+    // incremental attacks: every piece's attack set is kept per square, and after a move only the pieces that moved
+    // or whose rays ran into a square that changed are looked up again; generation and the danger map then read the cache
+    void setIncrementalAttacks(bool on);
+    bool incrementalAttacks() const { return _incremental; }
+
+    // "pext" or "magic", whichever slider lookup this cpu got
+    static const char* sliderBackend();
+
+    //debug :)
+    void PrintChessBoards();
+
+private:
+    // the side to move picked at compile time, the public versions just dispatch on _sideToMove
+    template <Color Us> void generateMoves(MoveList&, GenType, uint64_t);
+    template <Color Us> bool hasLegalMove();
+    template <Color Us> void makeMove(BitMove);
+    template <Color Us> void unmakeMove(BitMove);
+
+    static void ensureTables();
+    static bool initTables();
+    static void getZobristkeys();
+    void addMoves(MoveList&, int, uint64_t, uint64_t);
+
+    // knight
+    void generateKnightmoves(MoveList&, BitboardElement, uint64_t, uint64_t);
+
+    // King
+    template <Color Us> void generateKingmoves(MoveList&, BitboardElement, uint64_t, uint64_t, uint64_t, bool);
+
+    // pawns
+    template <Color Us> void generatePawnmoves(MoveList&, uint64_t, uint64_t, uint64_t, uint64_t, GenType);
+    template <Color Us> void generateEnPassant(MoveList&, uint64_t);
+    static void addPawnMoves(MoveList&, uint64_t, int, int);
+    static void addPawnPromotions(MoveList&, uint64_t, int, int);
+
+    // sliders (magic or pext bitboards)
+    static void pickSliderBackend();
+    static void getBishopmoves();
+    static void getRookmoves();
+    void generateBishopmoves(MoveList&, BitboardElement, uint64_t, uint64_t);
+    void generateRookmoves(MoveList&, BitboardElement, uint64_t, uint64_t);
+    void generateQueenmoves(MoveList&, BitboardElement, uint64_t, uint64_t);
+    static uint64_t bishopAttacks(int, uint64_t);
+    static uint64_t rookAttacks(int, uint64_t);
+    // what the piece on square attacks given occupied, from the tables
+    uint64_t attacksFrom(int square, uint64_t occupied) const;
+    void refreshAttacks(uint64_t changed);
+    bool _incremental = false;
+    uint64_t _pieceAttacks[64];
+
+    // legality (pins and checks), computed once per position by generateAllCurrentMoves
+    static void getLinemasks();
+    template <Color Us> uint64_t attackedSquares(uint64_t) const;
+    template <Color Us> uint64_t pinnedPieces(int, uint64_t, uint64_t);
+    template <Color Us> uint64_t computeLegality(uint64_t, uint64_t, uint64_t);
+    ChessPiece leastValuableAttacker(uint64_t attackers, int player, uint64_t& attackerBit) const;
+    uint64_t xrayAttackers(int square, ChessPiece removed, uint64_t occupied) const;
+    uint64_t legalTargets(int fromSquare) const;
+    template <Color Us> bool enPassantIsLegal(int, int);
+    uint64_t _checkers = 0ULL;
+    uint64_t _pinned = 0ULL;
+    uint64_t _checkMask = ~0ULL;
+    int _kingSquare = -1;
+    uint64_t _danger = 0ULL;
+    bool _legalityValid = false;
+
+    //board:
+    BitboardElement ChessBoard[12];
+    // let 0-5 be white and 6-11 be black
+    uint8_t _pieceOn[64];
+
+    void ClearChessBoards();
+
+    int _sideToMove = 0;
+    int _halfmoveClock = 0;
+    int _fullmoveNumber = 1;
+    uint64_t _hash = 0ULL;
+    uint64_t _materialKey = 0ULL;
+
+    // Pawn helpers
+    int enPassantSquare = -1;
+
+    // Castling, a mask of CastlingRights
+    int _castlingRights = AllCastling;
+
+    // undo entries for the last MaxUndo moves, deep enough for any search or game
+    static constexpr int MaxUndo = 1024;
+    UndoInfo _undoStack[MaxUndo];
+    int _undoCount = 0;
+
+};
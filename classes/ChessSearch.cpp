@@ -0,0 +1,211 @@
+#include "ChessSearch.h"
+#include "ChessEvaluation.h"
+#include "MovePicker.h"
+#include <algorithm>
+
+// mate scores are stored relative to the node, not the root, so they stay right wherever the position comes up again
+static int scoreToTable(int score, int ply) {
+    if (score >= MateScore - MaxPly) {
+        return score + ply;
+    }
+    if (score <= -MateScore + MaxPly) {
+        return score - ply;
+    }
+    return score;
+}
+
+static int scoreFromTable(int score, int ply) {
+    if (score >= MateScore - MaxPly) {
+        return score - ply;
+    }
+    if (score <= -MateScore + MaxPly) {
+        return score + ply;
+    }
+    return score;
+}
+
+ChessSearch::Result ChessSearch::search(const ChessPosition& position, const Limits& limits) {
+    _position = position;
+    _nodes = 0;
+    _stopped = false;
+    _timeMs = limits.timeMs;
+    _start = std::chrono::steady_clock::now();
+    _rootMove = NoMove;
+    std::fill(&_killers[0][0], &_killers[0][0] + MaxPly * 2, NoMove);
+    _table.newSearch();
+
+    Result result;
+    for (int depth = 1; depth <= std::min(limits.maxDepth, MaxPly - 1); depth++) {
+        _iterationMove = NoMove;
+        int score = negamax(depth, 0, -MateScore, MateScore);
+        // an iteration cut short only looked at some of the root moves, so its answer is thrown away
+        if (_stopped) {
+            break;
+        }
+        _rootMove = _iterationMove;
+        result.bestMove = _iterationMove;
+        result.score = score;
+        result.depth = depth;
+
+        // nothing to play, or a forced mate already found, deeper won't change the move
+        if (_iterationMove == NoMove || std::abs(score) >= MateScore - MaxPly) {
+            break;
+        }
+        // the next iteration takes a few times as long as this one, don't start what can't finish
+        if (_timeMs && elapsedMs() * 2 >= _timeMs) {
+            break;
+        }
+    }
+    result.nodes = _nodes;
+    return result;
+}
+
+int ChessSearch::elapsedMs() const {
+    return (int) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start).count();
+}
+
+// looking at the clock every node would cost more than the search itself
+void ChessSearch::countNode() {
+    if ((++_nodes & 2047) == 0 && _timeMs && _rootMove != NoMove && elapsedMs() >= _timeMs) {
+        _stopped = true;
+    }
+}
+
+int ChessSearch::negamax(int depth, int ply, int alpha, int beta) {
+    countNode();
+    if (_stopped) {
+        return 0;
+    }
+    // a position seen before on this line or in the game is a draw, the side ahead will avoid it
+    if (ply > 0 && (_position.repetitionCount() > 0 || _position.getHalfmoveClock() >= 100)) {
+        return 0;
+    }
+    bool inCheck = _position.inCheck();
+    // look one ply further when in check, so a check near the horizon can't hide a mate
+    if (inCheck) {
+        depth++;
+    }
+    if (depth <= 0 || ply >= MaxPly - 1) {
+        return quiescence(ply, alpha, beta);
+    }
+
+    // a result at least this deep settles the node, or at least tells us which move to try first
+    TTEntry entry;
+    BitMove hashMove = NoMove;
+    if (_table.probe(_position.getHash(), entry)) {
+        hashMove = entry.move;
+        int score = scoreFromTable(entry.score, ply);
+        if (ply > 0 && entry.depth >= depth
+            && (entry.bound == ExactBound || (entry.bound == LowerBound && score >= beta) || (entry.bound == UpperBound && score <= alpha))) {
+            return score;
+        }
+    }
+    // the table may have lost the root to a collision, the last iteration's answer is still known
+    if (ply == 0 && _rootMove != NoMove) {
+        hashMove = _rootMove;
+    }
+
+    MovePicker picker(_position, hashMove, _killers[ply]);
+    BitMove move;
+    int best = -MateScore;
+    BitMove bestMove = NoMove;
+    int startAlpha = alpha;
+    int legalMoves = 0;
+    while (picker.next(move)) {
+        legalMoves++;
+        _position.makeMove(move);
+        int score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+        _position.unmakeMove(move);
+        if (_stopped) {
+            return 0;
+        }
+
+        if (score > best) {
+            best = score;
+            bestMove = move;
+            if (ply == 0) {
+                _iterationMove = move;
+            }
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (alpha >= beta) {
+            // a quiet move that refuted this line will likely refute its siblings too
+            if (!move.isCapture() && !move.isPromotion() && move != _killers[ply][0]) {
+                _killers[ply][1] = _killers[ply][0];
+                _killers[ply][0] = move;
+            }
+            break;
+        }
+    }
+
+    if (legalMoves == 0) {
+        return inCheck ? -MateScore + ply : 0;
+    }
+    Bound bound = best >= beta ? LowerBound : (best > startAlpha ? ExactBound : UpperBound);
+    _table.store(_position.getHash(), depth, bound, scoreToTable(best, ply), bestMove);
+    return best;
+}
+
+// only captures and promotions, until the position is quiet enough for evaluate() to be trusted
+// in check every evasion is searched instead, standing pat is no option there
+int ChessSearch::quiescence(int ply, int alpha, int beta) {
+    countNode();
+    if (_stopped) {
+        return 0;
+    }
+    if (ply >= MaxPly) {
+        return evaluate(_position);
+    }
+
+    // any stored result will do here, quiescence is as shallow as it gets
+    TTEntry entry;
+    BitMove hashMove = NoMove;
+    if (_table.probe(_position.getHash(), entry)) {
+        hashMove = entry.move;
+        int score = scoreFromTable(entry.score, ply);
+        if (entry.bound == ExactBound || (entry.bound == LowerBound && score >= beta) || (entry.bound == UpperBound && score <= alpha)) {
+            return score;
+        }
+    }
+
+    bool inCheck = _position.inCheck();
+    int best = -MateScore + ply;
+    int startAlpha = alpha;
+    BitMove bestMove = NoMove;
+    if (!inCheck) {
+        best = evaluate(_position);
+        if (best >= beta) {
+            _table.store(_position.getHash(), 0, LowerBound, scoreToTable(best, ply), NoMove);
+            return best;
+        }
+        alpha = std::max(alpha, best);
+    }
+
+    MovePicker picker = inCheck ? MovePicker(_position, hashMove, nullptr) : MovePicker(_position, hashMove);
+    BitMove move;
+    // out of check the picker already left out the captures that lose material on the exchange
+    while (picker.next(move)) {
+        _position.makeMove(move);
+        int score = -quiescence(ply + 1, -beta, -alpha);
+        _position.unmakeMove(move);
+        if (_stopped) {
+            return 0;
+        }
+
+        if (score > best) {
+            best = score;
+            bestMove = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (alpha >= beta) {
+            break;
+        }
+    }
+    Bound bound = best >= beta ? LowerBound : (best > startAlpha ? ExactBound : UpperBound);
+    _table.store(_position.getHash(), 0, bound, scoreToTable(best, ply), bestMove);
+    return best;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ChessPosition.h"
+#include "TranspositionTable.h"
+#include <chrono>
+
+// scores are centipawns from the side to move's point of view, a mate found ply plies from the root
+// scores MateScore - ply, so shorter mates always win out
+inline constexpr int MateScore = 32000;
+inline constexpr int MaxPly = 64;
+
+//
+// negamax alpha-beta with iterative deepening and a captures only quiescence search at the leaves
+// moves come from the MovePicker, ordered by the hash move, killers and mvv-lva
+// results go to a transposition table that is shared with any other search using it and kept between searches
+// every iteration that finishes leaves a complete answer, so running out of time only costs the one in progress
+//
+class ChessSearch
+{
+public:
+    explicit ChessSearch(TranspositionTable& table)
+        : _table(table) { }
+
+    struct Limits
+    {
+        int maxDepth = 5;
+        // stops deepening once this much time is gone, 0 for no limit
+        int timeMs = 0;
+    };
+
+    struct Result
+    {
+        BitMove bestMove = NoMove;
+        int score = 0;
+        // deepest iteration that finished
+        int depth = 0;
+        uint64_t nodes = 0;
+    };
+
+    // searches a copy of position, the caller's board is never touched
+    Result search(const ChessPosition& position, const Limits& limits);
+
+private:
+    int negamax(int depth, int ply, int alpha, int beta);
+    int quiescence(int ply, int alpha, int beta);
+    void countNode();
+    int elapsedMs() const;
+
+    TranspositionTable& _table;
+    ChessPosition _position;
+    BitMove _killers[MaxPly][2];
+    // best move of the last finished iteration, tried first at the root
+    BitMove _rootMove = NoMove;
+    BitMove _iterationMove = NoMove;
+
+    uint64_t _nodes = 0;
+    bool _stopped = false;
+    int _timeMs = 0;
+    std::chrono::steady_clock::time_point _start;
+};
@@ -0,0 +1,142 @@
+#include "MovePicker.h"
+#include <utility>
+
+MovePicker::MovePicker(ChessPosition& position, BitMove hashMove, const BitMove killers[2])
+    : _position(position), _hashMove(hashMove)
+{
+    if (killers) {
+        _killers[0] = killers[0];
+        _killers[1] = killers[1];
+    }
+}
+
+MovePicker::MovePicker(ChessPosition& position, BitMove hashMove)
+    : _position(position), _capturesOnly(true), _hashMove(hashMove)
+{
+    // a quiet hash move has no place in a captures only search
+    if (!_hashMove.isCapture() && !_hashMove.isPromotion()) {
+        _hashMove = NoMove;
+    }
+}
+
+bool MovePicker::next(BitMove& move) {
+    switch (_stage) {
+    case HashStage:
+        _stage = GenerateCaptures;
+        if (_position.isLegal(_hashMove)) {
+            move = _hashMove;
+            return true;
+        }
+        _hashMove = NoMove;
+        [[fallthrough]];
+
+    case GenerateCaptures:
+        _position.generateMoves(_moves, GenCaptures);
+        for (int i = 0; i < _moves.size(); i++) {
+            _scores[i] = captureScore(_moves[i]);
+        }
+        _current = 0;
+        _stage = CaptureStage;
+        [[fallthrough]];
+
+    case CaptureStage:
+        while (_current < _moves.size()) {
+            move = pickBest();
+            if (move == _hashMove) {
+                continue;
+            }
+            // captures that lose material on the exchange wait until after the quiets,
+            // and a captures only search never plays them at all
+            if (move.isCapture() && !move.isPromotion() && !_position.seeGreaterEqual(move, 0)) {
+                if (!_capturesOnly) {
+                    _badCaptures.add(move.from(), move.to(), move.flags());
+                }
+                continue;
+            }
+            return true;
+        }
+        if (_capturesOnly) {
+            _stage = Done;
+            return false;
+        }
+        _stage = KillerStage;
+        [[fallthrough]];
+
+    case KillerStage:
+        // killers are quiet moves that cut off a sibling, they may not even be legal here
+        while (_killerIndex < 2) {
+            move = _killers[_killerIndex++];
+            if (move != _hashMove && !move.isCapture() && !move.isPromotion() && _position.isLegal(move)) {
+                return true;
+            }
+        }
+        _stage = GenerateQuiets;
+        [[fallthrough]];
+
+    case GenerateQuiets:
+        _position.generateMoves(_moves, GenQuiets);
+        _current = 0;
+        _stage = QuietStage;
+        [[fallthrough]];
+
+    case QuietStage:
+        while (_current < _moves.size()) {
+            move = _moves[_current++];
+            if (!isDuplicate(move)) {
+                return true;
+            }
+        }
+        _current = 0;
+        _stage = BadCaptureStage;
+        [[fallthrough]];
+
+    case BadCaptureStage:
+        if (_current < _badCaptures.size()) {
+            move = _badCaptures[_current++];
+            return true;
+        }
+        _stage = Done;
+        [[fallthrough]];
+
+    case Done:
+        break;
+    }
+    return false;
+}
+
+// most valuable victim first, cheapest attacker breaking ties
+int MovePicker::captureScore(BitMove move) const {
+    ChessPiece attacker = _position.pieceTypeOn(move.from());
+    ChessPiece victim = (move.flags() == EnPassantCapture) ? Pawn : _position.pieceTypeOn(move.to());
+
+    int score = PieceValues[victim] * 16 - PieceValues[attacker] / 100;
+    if (move.isPromotion()) {
+        score += PieceValues[move.promotion()] * 16;
+    }
+    return score;
+}
+
+BitMove MovePicker::pickBest() {
+    int best = _current;
+    for (int i = _current + 1; i < _moves.size(); i++) {
+        if (_scores[i] > _scores[best]) {
+            best = i;
+        }
+    }
+    std::swap(_moves[_current], _moves[best]);
+    std::swap(_scores[_current], _scores[best]);
+    return _moves[_current++];
+}
+
+bool MovePicker::isDuplicate(BitMove move) const {
+    if (move == _hashMove) {
+        return true;
+    }
+    // a killer showing up here was either handed out already or matched the hash move
+    for (int i = 0; i < 2; i++) {
+        if (move == _killers[i]) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ChessPosition.h"
+
+//
+// hands out the moves of a position one at a time, best guesses first
+// each stage is only generated once the ones before it failed to cut off:
+//   hash move, captures (mvv-lva), killers, quiets, captures that lose material (see < 0)
+// the quiescence constructor skips the killers and quiets, and drops the losing captures instead of deferring them
+//
+class MovePicker
+{
+public:
+    MovePicker(ChessPosition& position, BitMove hashMove, const BitMove killers[2]);
+    MovePicker(ChessPosition& position, BitMove hashMove);
+
+    // false once every move has been handed out
+    bool next(BitMove& move);
+
+private:
+    enum Stage
+    {
+        HashStage,
+        GenerateCaptures,
+        CaptureStage,
+        KillerStage,
+        GenerateQuiets,
+        QuietStage,
+        BadCaptureStage,
+        Done
+    };
+
+    int captureScore(BitMove move) const;
+    // takes the best scored move left in the list and swaps it to the front
+    BitMove pickBest();
+    bool isDuplicate(BitMove move) const;
+
+    ChessPosition& _position;
+    Stage _stage = HashStage;
+    bool _capturesOnly = false;
+
+    BitMove _hashMove;
+    BitMove _killers[2] = { NoMove, NoMove };
+    int _killerIndex = 0;
+
+    MoveList _moves;
+    MoveList _badCaptures;
+    int _scores[MoveList::Capacity];
+    int _current = 0;
+};
@@ -0,0 +1,79 @@
+#include "TranspositionTable.h"
+#include <bit>
+
+void TranspositionTable::resize(size_t megabytes) {
+    size_t count = 0;
+    size_t bytes = megabytes * 1024 * 1024;
+    if (bytes >= sizeof(Cluster)) {
+        count = std::bit_floor(bytes / sizeof(Cluster));
+    }
+    _clusters = std::vector<Cluster>(count);
+    _mask = count ? count - 1 : 0;
+    _age = 0;
+}
+
+uint64_t TranspositionTable::pack(int depth, Bound bound, int score, BitMove move, int age) {
+    return (uint64_t) move.data
+         | (uint64_t)(uint16_t)(int16_t) score << 16
+         | (uint64_t)(depth & 0xFF) << 32
+         | (uint64_t) bound << 40
+         | (uint64_t) age << 42;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+    if (_clusters.empty()) {
+        return false;
+    }
+    const Cluster& cluster = _clusters[key & _mask];
+    for (const Entry& slot : cluster.entries) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || !data) {
+            continue;
+        }
+        entry.move.data = (uint16_t) data;
+        entry.score = (int16_t)(data >> 16);
+        entry.depth = depthOf(data);
+        entry.bound = (Bound)((data >> 40) & 3);
+        return true;
+    }
+    return false;
+}
+
+// the same position is overwritten in place, keeping its old move when the new result has none
+// otherwise the cluster gives up its least useful entry: the shallowest, with every search of age counting as 8 plies
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score, BitMove move) {
+    if (_clusters.empty()) {
+        return;
+    }
+    Cluster& cluster = _clusters[key & _mask];
+    Entry* replace = &cluster.entries[0];
+    int replaceValue = 1 << 30;
+    for (Entry& slot : cluster.entries) {
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data) {
+            // a deeper result from this same search is worth more than a shallow bound
+            if (bound != ExactBound && ageOf(data) == _age && depth < depthOf(data) - 2) {
+                return;
+            }
+            if (move == NoMove) {
+                move.data = (uint16_t) data;
+            }
+            replace = &slot;
+            break;
+        }
+        int value = depthOf(data) - 8 * ((_age - ageOf(data)) & AgeMask);
+        if (!data) {
+            value = -(1 << 30);
+        }
+        if (value < replaceValue) {
+            replaceValue = value;
+            replace = &slot;
+        }
+    }
+
+    uint64_t data = pack(depth, bound, score, move, _age);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->check.store(key ^ data, std::memory_order_relaxed);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Bitboard.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// what a stored score says about the real one
+enum Bound
+{
+    NoBound = 0,
+    UpperBound = 1, // failed low, the real score is at most this
+    LowerBound = 2, // failed high, at least this
+    ExactBound = 3
+};
+
+// one probed entry, unpacked
+struct TTEntry
+{
+    BitMove move = NoMove;
+    int score = 0;
+    int depth = 0;
+    Bound bound = NoBound;
+};
+
+//
+// search results by zobrist key, shared by every search (and every thread) that holds a reference, without locks
+// a key maps to a cluster of four entries on one cache line; an entry keeps key ^ data next to data, so a torn
+// write from two threads fails the key check instead of handing back someone else's move
+// the table outlives the searches: newSearch() only bumps the age, and entries from older searches are the
+// first to be replaced
+//
+class TranspositionTable
+{
+public:
+    // drops everything, a size of 0 turns the table off and gives its memory back
+    void resize(size_t megabytes);
+    bool empty() const { return _clusters.empty(); }
+    // call before every search, so what the last one left behind ages
+    void newSearch() { _age = (_age + 1) & AgeMask; }
+
+    bool probe(uint64_t key, TTEntry& entry) const;
+    void store(uint64_t key, int depth, Bound bound, int score, BitMove move);
+
+private:
+    static constexpr int ClusterSize = 4;
+    static constexpr int AgeMask = 63;
+
+    struct Entry
+    {
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    struct alignas(64) Cluster
+    {
+        Entry entries[ClusterSize];
+    };
+
+    // data: move in bits 0-15, score in 16-31, depth in 32-39, bound in 40-41, age in 42-47
+    static uint64_t pack(int depth, Bound bound, int score, BitMove move, int age);
+    static int ageOf(uint64_t data) { return (int)(data >> 42) & AgeMask; }
+    static int depthOf(uint64_t data) { return (int)(data >> 32) & 0xFF; }
+
+    std::vector<Cluster> _clusters;
+    uint64_t _mask = 0;
+    int _age = 0;
+};